@@ -1,11 +1,441 @@
 #include "./filtered_string_view.h"
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <ios>
+#include <limits>
 #include <string>
 #include <utility>
 #include <algorithm>
 
+namespace {
+    // View of the characters in [first, last) which satisfy predicate. The view is bounded by last, so it
+    // never reads past the range and costs only last - first to traverse
+    auto subrange(const fsv::filter &predicate, const char *first, const char *last) -> fsv::filtered_string_view {
+        return fsv::filtered_string_view(first, static_cast<std::size_t>(last - first), predicate);
+    }
+
+    // View of the characters of fsv which lie in the range [first, last) of its underlying string
+    auto subrange(const fsv::filtered_string_view &fsv, const char *first, const char *last) -> fsv::filtered_string_view {
+        return subrange(fsv.predicate(), first, last);
+    }
+
+    // Aho-Corasick automaton over a set of delimiters, with the failure links folded into a full transition table
+    class delimiter_automaton {
+    public:
+        static constexpr auto no_match = -1;
+
+        explicit delimiter_automaton(const std::vector<std::string> &delimiters) {
+            add_node();
+            for (auto i = 0; i < static_cast<int>(delimiters.size()); ++i) {
+                // An empty delimiter would end at the root and so match after every character
+                if (delimiters[static_cast<std::size_t>(i)].empty()) {
+                    continue;
+                }
+                auto node = 0;
+                for (const auto c : delimiters[static_cast<std::size_t>(i)]) {
+                    const auto byte = static_cast<unsigned char>(c);
+                    if (next_[static_cast<std::size_t>(node)][byte] == 0) {
+                        const auto child = add_node();
+                        next_[static_cast<std::size_t>(node)][byte] = child;
+                    }
+                    node = next_[static_cast<std::size_t>(node)][byte];
+                }
+                // The first of several identical delimiters wins
+                if (match_[static_cast<std::size_t>(node)] == no_match) {
+                    match_[static_cast<std::size_t>(node)] = i;
+                }
+            }
+            link();
+        }
+
+        auto next(int node, char c) const noexcept -> int {
+            return next_[static_cast<std::size_t>(node)][static_cast<unsigned char>(c)];
+        }
+
+        // Index of the longest delimiter ending at node, or no_match
+        auto match(int node) const noexcept -> int {
+            return match_[static_cast<std::size_t>(node)];
+        }
+
+    private:
+        std::vector<std::array<int, 256>> next_;
+        std::vector<int> match_;
+
+        auto add_node() -> int {
+            next_.push_back(std::array<int, 256>{});
+            match_.push_back(no_match);
+            return static_cast<int>(next_.size()) - 1;
+        }
+
+        // Breadth first, so that a node's failure target is finished before the node itself
+        auto link() -> void {
+            auto fail = std::vector<int>(next_.size(), 0);
+            auto queue = std::vector<int>{};
+            for (const auto child : next_[0]) {
+                if (child != 0) {
+                    queue.push_back(child);
+                }
+            }
+            for (auto i = std::size_t{0}; i < queue.size(); ++i) {
+                const auto node = static_cast<std::size_t>(queue[i]);
+                const auto node_fail = static_cast<std::size_t>(fail[node]);
+                // A shorter delimiter ending here is only reported if no longer one does
+                if (match_[node] == no_match) {
+                    match_[node] = match_[node_fail];
+                }
+                for (auto byte = std::size_t{0}; byte < 256; ++byte) {
+                    auto &child = next_[node][byte];
+                    if (child != 0) {
+                        fail[static_cast<std::size_t>(child)] = next_[node_fail][byte];
+                        queue.push_back(child);
+                    } else {
+                        child = next_[node_fail][byte];
+                    }
+                }
+            }
+        }
+    };
+
+    // Knuth-Morris-Pratt failure function of tok: failure[k] is the length of the longest proper prefix of tok[0, k)
+    // which is also a suffix of it
+    template <typename String, typename Table>
+    auto kmp_failure(const String &tok, Table &failure) -> void {
+        failure.assign(tok.size() + 1, 0);
+        for (auto k = std::size_t{2}; k <= tok.size(); ++k) {
+            auto pos = failure[k - 1];
+            while (pos != 0 && tok[k - 1] != tok[pos]) {
+                pos = failure[pos];
+            }
+            failure[k] = tok[k - 1] == tok[pos] ? pos + 1 : 0;
+        }
+    }
+
+    // The number of characters of tok matched once c follows a partial match of pos < tok.size() characters. On a
+    // mismatch the partial match falls back to the longest prefix of tok it still ends with, rather than to nothing,
+    // so that a delimiter overlapping a failed partial match is still found
+    template <typename String, typename Table>
+    auto kmp_advance(const String &tok, const Table &failure, std::size_t pos, char c) noexcept -> std::size_t {
+        while (pos != 0 && c != tok[pos]) {
+            pos = failure[pos];
+        }
+        return c == tok[pos] ? pos + 1 : 0;
+    }
+
+    // A delimiter found by parallel_split: the offsets of its first character and one past its last character in the
+    // underlying string, and the filtered index of its first character
+    struct delimiter_match {
+        std::size_t first;
+        std::size_t last;
+        std::size_t index;
+    };
+
+    // The matching of find_delimiter_positions, stepped one filtered character at a time so that it can be started
+    // part way through a string in any state
+    class delimiter_matcher {
+    public:
+        delimiter_matcher(const std::string &tok, const std::vector<std::size_t> &failure):
+        tok_{&tok}, failure_{&failure}, offsets_(tok.size()) {}
+
+        // Advances over the filtered character c at offset, which has filtered index index. Returns true if this
+        // completes a delimiter, which match() then describes
+        auto step(char c, std::size_t offset, std::size_t index) noexcept -> bool {
+            offsets_[seen_++ % offsets_.size()] = offset;
+            tok_pos_ = kmp_advance(*tok_, *failure_, tok_pos_, c);
+            if (tok_pos_ != tok_->size()) {
+                return false;
+            }
+            tok_pos_ = 0;
+            first_ = offsets_[seen_ % offsets_.size()];
+            index_ = index + 1 - tok_->size();
+            return true;
+        }
+
+        auto match(std::size_t offset) const noexcept -> delimiter_match {
+            return delimiter_match{first_, offset + 1, index_};
+        }
+
+        // Two matchers in the same state will behave identically from here on. A partial match of the same length
+        // also ended at the same character, so the offsets it covers need not be compared
+        friend auto operator==(const delimiter_matcher &lhs, const delimiter_matcher &rhs) noexcept -> bool {
+            return lhs.tok_pos_ == rhs.tok_pos_;
+        }
+
+        auto matching() const noexcept -> bool {
+            return tok_pos_ != 0;
+        }
+
+    private:
+        const std::string *tok_;
+        const std::vector<std::size_t> *failure_;
+        std::vector<std::size_t> offsets_; // Offsets of the last tok_->size() filtered characters, as a ring
+        std::size_t seen_ = 0; // Number of filtered characters stepped over
+        std::size_t tok_pos_ = 0; // Number of characters of tok matched so far
+        std::size_t first_ = 0; // Offset of the first character of the last delimiter matched
+        std::size_t index_ = 0; // Filtered index of the first character of the last delimiter matched
+    };
+
+    // The result of scanning one chunk of a parallel_split from the initial matcher state. Filtered indexes are
+    // relative to the start of the chunk until stitched
+    struct chunk_scan {
+        std::vector<delimiter_match> matches;
+        std::size_t count; // Number of filtered characters in the chunk
+        delimiter_matcher matcher; // State at the end of the chunk
+    };
+
+    auto scan_chunk(const fsv::filtered_string_view &fsv, const std::string &tok, const std::vector<std::size_t> &failure,
+                    std::size_t first, std::size_t last) -> chunk_scan {
+        auto scan = chunk_scan{{}, 0, delimiter_matcher(tok, failure)};
+        const auto &predicate = fsv.predicate();
+        for (auto offset = first; offset != last; ++offset) {
+            const auto c = fsv.data()[offset];
+            if (predicate(c)) {
+                if (scan.matcher.step(c, offset, scan.count)) {
+                    scan.matches.push_back(scan.matcher.match(offset));
+                }
+                ++scan.count;
+            }
+        }
+        return scan;
+    }
+
+    // The first 16 filtered characters of a view packed big endian into two words, so that comparing keys orders views
+    // as operator<=> would. Characters are offset so that comparing them unsigned agrees with comparing them as char
+    struct sort_key {
+        std::uint64_t high;
+        std::uint64_t low;
+        std::size_t length; // Number of filtered characters in the key, at most 16
+        std::size_t index; // Position of the view the key was extracted from
+
+        static constexpr auto max_length = std::size_t{16};
+
+        // Whether the views may differ beyond the characters in the key
+        auto truncated() const noexcept -> bool {
+            return length == max_length;
+        }
+
+        auto compare(const sort_key &other) const noexcept -> std::strong_ordering {
+            if (high != other.high) {
+                return high <=> other.high;
+            }
+            if (low != other.low) {
+                return low <=> other.low;
+            }
+            return length <=> other.length;
+        }
+    };
+
+    auto make_sort_key(const fsv::filtered_string_view &fsv, std::size_t index) -> sort_key {
+        auto key = sort_key{0, 0, 0, index};
+        const auto &predicate = fsv.predicate();
+        const auto last = fsv.data() + fsv.length();
+        for (auto c = fsv.data(); c != last && key.length < sort_key::max_length; ++c) {
+            if (predicate(*c)) {
+                const auto byte = static_cast<std::uint64_t>(static_cast<unsigned char>(*c - std::numeric_limits<char>::min()));
+                auto &word = key.length < 8 ? key.high : key.low;
+                word |= byte << (8 * (7 - key.length % 8));
+                ++key.length;
+            }
+        }
+        return key;
+    }
+
+    auto make_sort_keys(const std::vector<fsv::filtered_string_view> &views) -> std::vector<sort_key> {
+        auto keys = std::vector<sort_key>{};
+        keys.reserve(views.size());
+        for (auto i = std::size_t{0}; i < views.size(); ++i) {
+            keys.push_back(make_sort_key(views[i], i));
+        }
+        return keys;
+    }
+
+    // Calls visit with each character of fsv, walking the underlying string directly rather than through iterators
+    template <typename Visit>
+    auto visit_filtered(const fsv::filtered_string_view &fsv, Visit visit) -> void {
+        const auto &predicate = fsv.predicate();
+        const auto last = fsv.data() + fsv.length();
+        for (auto c = fsv.data(); c != last; ++c) {
+            if (predicate(*c)) {
+                visit(*c);
+            }
+        }
+    }
+
+    // Calls visit with each character of tsv, filtering and transforming in the same pass
+    template <typename Visit>
+    auto visit_transformed(const fsv::transformed_string_view &tsv, Visit visit) -> void {
+        visit_filtered(tsv.view(), [&tsv, &visit](const char c) { visit(tsv.apply(c)); });
+    }
+
+    // FNV-1a, so that hashes can be built up one character at a time across fragments
+    constexpr auto fnv_offset_basis = std::uint64_t{14695981039346656037u};
+
+    auto fnv1a(std::uint64_t hash, const char c) noexcept -> std::uint64_t {
+        return (hash ^ static_cast<unsigned char>(c)) * std::uint64_t{1099511628211u};
+    }
+
+    // Compares the filtered characters of fsv against other in place, stopping at the first difference
+    auto filtered_equals(const fsv::filtered_string_view &fsv, std::string_view other) -> bool {
+        const auto &predicate = fsv.predicate();
+        const auto last = fsv.data() + fsv.length();
+        auto i = std::size_t{0};
+        for (auto c = fsv.data(); c != last; ++c) {
+            if (predicate(*c)) {
+                if (i == other.size() || other[i] != *c) {
+                    return false;
+                }
+                ++i;
+            }
+        }
+        return i == other.size();
+    }
+
+    template <typename String>
+    auto materialise(const fsv::filtered_string_view &fsv, String &string) -> void {
+        // Without an index, size() would be a pass of its own
+        if (fsv.has_index()) {
+            string.reserve(fsv.size());
+        }
+        for (const auto c : fsv) {
+            string += c;
+        }
+    }
+
+    // Adds the indexes of the beginning and end of the delimiter apperances in fsv to the delimiter_pos vector
+    template <typename Positions>
+    auto find_delimiter_positions(const fsv::filtered_string_view &fsv, const fsv::filtered_string_view &tok,
+                                  Positions &delimiter_pos) -> void {
+        // The pattern and its failure table are allocated as delimiter_pos is
+        using allocator_traits = std::allocator_traits<typename Positions::allocator_type>;
+        using string_allocator = typename allocator_traits::template rebind_alloc<char>;
+        using table_allocator = typename allocator_traits::template rebind_alloc<std::size_t>;
+        auto pattern = std::basic_string<char, std::char_traits<char>, string_allocator>(delimiter_pos.get_allocator());
+        materialise(tok, pattern);
+        auto failure = std::vector<std::size_t, table_allocator>(delimiter_pos.get_allocator());
+        kmp_failure(pattern, failure);
+        auto index = 0;
+        auto tok_pos = std::size_t{0};
+
+        // Using string matching, find all occurences of tok inside fsv
+        for (const auto &c : fsv) {
+            tok_pos = kmp_advance(pattern, failure, tok_pos, c);
+            if (tok_pos == pattern.size()) {
+                delimiter_pos.push_back(index + 1 - static_cast<int>(pattern.size()));
+                delimiter_pos.push_back(index + 1);
+                tok_pos = 0;
+            }
+            ++index;
+        }
+        delimiter_pos.push_back(index);
+    }
+
+    // Both delimiter_pos and split_strings are passed in so that the caller decides where they are allocated
+    template <typename Positions, typename Strings>
+    auto split(const fsv::filtered_string_view &fsv, const fsv::filtered_string_view &tok, Positions &delimiter_pos,
+               Strings &split_strings) -> void {
+        // If the tok is empty, return a copy of fsv
+        if (tok.size() == 0) {
+            split_strings.push_back(fsv);
+            return;
+        }
+        delimiter_pos.push_back(0);
+        find_delimiter_positions(fsv, tok, delimiter_pos);
+        // Walk the underlying string once alongside the delimiter positions, finding the filtered character at each
+        // index so that every piece is a bounded view sharing the predicate of fsv
+        const auto &predicate = fsv.predicate();
+        const auto end = fsv.data() + fsv.length();
+        auto source = fsv.data();
+        auto index = 0; // Filtered index of the next filtered character at or after source
+        const auto seek = [&](int n) {
+            for (; source != end; ++source) {
+                if (predicate(*source)) {
+                    if (index == n) {
+                        break;
+                    }
+                    ++index;
+                }
+            }
+            return source;
+        };
+        auto delim_iter = delimiter_pos.begin();
+        // Iterating through the delimiter positions to add the substrings between each occurance of a delimiter
+        while (delim_iter != delimiter_pos.end()) {
+            const auto l = *delim_iter;
+            ++delim_iter;
+            const auto r = *delim_iter;
+            ++delim_iter;
+            if (r - l == 0) {
+                // If two delimiter occur consecutively, add an empty fsv
+                split_strings.push_back(fsv::filtered_string_view(""));
+            } else {
+                const auto first = seek(l);
+                split_strings.push_back(subrange(fsv, first, seek(r - 1) + 1));
+            }
+        }
+    }
+}
+
+fsv::match_index::match_index(const char *data, std::size_t length, const filter &predicate) {
+    bits_.reserve((length + word_bits - 1) / word_bits);
+    ranks_.reserve((length + block_bits - 1) / block_bits);
+    append(data, data + length, predicate);
+}
+
+auto fsv::match_index::append(const char *first, const char *last, const filter &predicate) -> void {
+    for (; first != last; ++first) {
+        if (length_ % block_bits == 0) {
+            ranks_.push_back(count_);
+        }
+        if (length_ % word_bits == 0) {
+            bits_.push_back(0);
+        }
+        if (predicate(*first)) {
+            bits_.back() |= std::uint64_t{1} << (length_ % word_bits);
+            ++count_;
+        }
+        ++length_;
+    }
+}
+
+auto fsv::match_index::rank(std::size_t pos) const noexcept -> std::size_t {
+    if (pos >= length_) {
+        return count_;
+    }
+    const auto word = pos / word_bits;
+    auto rank = static_cast<std::size_t>(ranks_[pos / block_bits]);
+    for (auto i = (pos / block_bits) * block_words; i < word; ++i) {
+        rank += static_cast<std::size_t>(std::popcount(bits_[i]));
+    }
+    const auto mask = (std::uint64_t{1} << (pos % word_bits)) - 1;
+    return rank + static_cast<std::size_t>(std::popcount(bits_[word] & mask));
+}
+
+auto fsv::match_index::select(std::size_t n) const noexcept -> std::size_t {
+    if (n >= count_) {
+        return length_;
+    }
+    // Find the last block which starts with at most n set bits before it, then walk its words
+    const auto block = static_cast<std::size_t>(std::upper_bound(ranks_.begin(), ranks_.end(), n) - ranks_.begin()) - 1;
+    auto remaining = n - static_cast<std::size_t>(ranks_[block]);
+    for (auto i = block * block_words; i < bits_.size(); ++i) {
+        auto word = bits_[i];
+        const auto count = static_cast<std::size_t>(std::popcount(word));
+        if (remaining < count) {
+            // Clear the lowest set bits until the one we are after is the lowest
+            for (; remaining > 0; --remaining) {
+                word &= word - 1;
+            }
+            return i * word_bits + static_cast<std::size_t>(std::countr_zero(word));
+        }
+        remaining -= count;
+    }
+    return length_;
+}
+
 auto fsv::filtered_string_view::operator=(const filtered_string_view &other) noexcept -> filtered_string_view {
     if (this != &other) {
         filtered_string_view(other).swap(*this);
@@ -19,6 +449,7 @@ auto fsv::filtered_string_view::operator=(filtered_string_view &&other) noexcept
         other.data_ = nullptr;
         other.length_ = 0;
         other.predicate_ = default_predicate;
+        other.index_.reset();
     }
     return *this;
 }
@@ -27,12 +458,23 @@ auto fsv::filtered_string_view::swap(filtered_string_view &other) noexcept -> vo
     std::swap(data_, other.data_);
     std::swap(length_, other.length_);
     std::swap(predicate_, other.predicate_);
+    std::swap(index_, other.index_);
+}
+
+auto fsv::filtered_string_view::build_index() -> void {
+    if (data_ != nullptr) {
+        index_ = std::make_shared<const match_index>(data_, length_, predicate_);
+    }
 }
 
 auto fsv::filtered_string_view::operator[](int n) const noexcept -> const char& {
+    if (index_) {
+        // Out of range indexes refer to the character just past the view, as in the unindexed scan below
+        return n < 0 ? data_[length_] : data_[std::min(index_->select(static_cast<std::size_t>(n)), length_)];
+    }
     auto temp = data_;
     auto i = 0;
-    while (*temp != '\0') {
+    while (temp != data_ + length_) {
         if (predicate_(*temp)) {
             if (i == n) {
                 break;
@@ -46,9 +488,7 @@ auto fsv::filtered_string_view::operator[](int n) const noexcept -> const char&
 
 fsv::filtered_string_view::operator std::string() const {
     auto string = std::string{};
-    for (const auto c : *this) {
-        string += c;
-    }
+    materialise(*this, string);
     return string;
 }
 
@@ -63,6 +503,9 @@ auto fsv::filtered_string_view::size() const noexcept -> std::size_t {
     if (data_ == nullptr) {
         return 0;
     }
+    if (index_) {
+        return index_->rank(length_);
+    }
     auto size = std::size_t{0};
     for (auto i = 0u; i < length_; ++i) {
         if (predicate_(*(data_ + i))) {
@@ -82,61 +525,51 @@ auto fsv::compose(const filtered_string_view &fsv, const std::vector<filter> &fi
         }
         return true;
     };
-    return(fsv::filtered_string_view(fsv.data(), pred));
+    return(fsv::filtered_string_view(fsv.data(), fsv.length(), pred));
+}
+
+auto fsv::compose(const filtered_string_view &fsv, const std::vector<filter> &filts, std::pmr::memory_resource *resource) -> filtered_string_view {
+    // Shared rather than captured by value, so that copying the view does not copy filts through the default
+    // resource. The polymorphic allocator passes resource on to the vector it constructs
+    const auto shared = std::allocate_shared<const std::pmr::vector<filter>>(std::pmr::polymorphic_allocator<>(resource),
+                                                                            filts.begin(), filts.end());
+    const auto pred = [shared](const char &c) -> bool {
+        for (const auto &f : *shared) {
+            if (!f(c)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    return(fsv::filtered_string_view(fsv.data(), fsv.length(), pred));
 }
 
 auto fsv::split(const filtered_string_view &fsv, const filtered_string_view &tok) -> std::vector<filtered_string_view> {
-    // If the tok is empty, return a copy of fsv
-    if (tok.size() == 0) {
-        return std::vector<filtered_string_view>{fsv};
-    }
-    auto delimiter_pos = std::vector<int>{0};
-    find_delimiter_positions(fsv, tok, delimiter_pos);
+    auto delimiter_pos = std::vector<int>{};
     auto split_strings = std::vector<filtered_string_view>{};
-    auto delim_iter = delimiter_pos.begin();
-    // Iterating through the delimiter positions to add the substrings between each occurance of a delimiter
-    while (delim_iter != delimiter_pos.end()) {
-        const auto l = *delim_iter;
-        ++delim_iter;
-        const auto r = *delim_iter;
-        ++delim_iter;
-        if (r - l == 0) {
-            // If two delimiter occur consecutively, add an empty fsv
-            split_strings.push_back(filtered_string_view(""));
-        } else {
-            split_strings.push_back(substr(fsv, l, r - l));
-        }
-    }
+    ::split(fsv, tok, delimiter_pos, split_strings);
+    return split_strings;
+}
+
+auto fsv::split(const filtered_string_view &fsv, const filtered_string_view &tok, std::pmr::memory_resource *resource) -> std::pmr::vector<filtered_string_view> {
+    auto delimiter_pos = std::pmr::vector<int>{resource};
+    auto split_strings = std::pmr::vector<filtered_string_view>{resource};
+    ::split(fsv, tok, delimiter_pos, split_strings);
     return split_strings;
 }
 
-// Adds the indexes of the beginning and end of the delimiter apperances in fsv to the delimiter_pos vector
 auto fsv::find_delimiter_positions(const filtered_string_view &fsv, const filtered_string_view &tok, std::vector<int> &delimiter_pos) -> void {
-    auto start = 0;
-    auto index = 0;
-    auto tok_iter = tok.begin();
-    auto delim = false;
-
-    // Using string matching, find all occurences of tok inside fsv
-    for (const auto &c : fsv) {
-        if (c == *tok_iter) {
-            if (!delim) {
-                start = index;
-                delim = true;
-            }
-            ++tok_iter;
-            if (tok_iter == tok.end() && delim) {
-                delim = false;
-                delimiter_pos.push_back(start);
-                delimiter_pos.push_back(index + 1);
-                tok_iter = tok.begin();
-            }
-        } else {
-            tok_iter = tok.begin();
-        }
-        ++index;
-    }
-    delimiter_pos.push_back(index);
+    ::find_delimiter_positions(fsv, tok, delimiter_pos);
+}
+
+auto fsv::find_delimiter_positions(const filtered_string_view &fsv, const filtered_string_view &tok, std::pmr::vector<int> &delimiter_pos) -> void {
+    ::find_delimiter_positions(fsv, tok, delimiter_pos);
+}
+
+auto fsv::to_string(const filtered_string_view &fsv, std::pmr::memory_resource *resource) -> std::pmr::string {
+    auto string = std::pmr::string{resource};
+    materialise(fsv, string);
+    return string;
 }
 
 auto fsv::substr(const filtered_string_view &fsv, int pos, int count) noexcept -> filtered_string_view {
@@ -149,5 +582,579 @@ auto fsv::substr(const filtered_string_view &fsv, int pos, int count) noexcept -
     const auto pred = [fsv, rcount, start, end](const char &c) -> bool {
         return (rcount != 0 && (&c >= start) && (&c <= end) && fsv.predicate()(c));
     };
-    return filtered_string_view(fsv.data(), pred);
-}
\ No newline at end of file
+    return filtered_string_view(fsv.data(), fsv.length(), pred);
+}
+
+auto fsv::tokenize(const filtered_string_view &fsv, const std::vector<filtered_string_view> &delimiters) -> std::vector<token> {
+    // Materialise the delimiters once, keeping their original indexes but never matching empty ones
+    auto patterns = std::vector<std::string>{};
+    auto max_length = std::size_t{0};
+    for (const auto &delimiter : delimiters) {
+        patterns.push_back(static_cast<std::string>(delimiter));
+        max_length = std::max(max_length, patterns.back().size());
+    }
+    if (max_length == 0) {
+        return std::vector<token>{token{fsv, -1}};
+    }
+
+    auto tokens = std::vector<token>{};
+    auto piece = fsv.data(); // Start of the current piece in the underlying string
+    auto piece_size = std::size_t{0}; // Filtered characters seen since the start of the current piece
+    // The positions of the last max_length filtered characters, to find where a completed delimiter began
+    auto recent = std::vector<const char*>(max_length);
+    const auto add_token = [&](std::size_t delimiter_length, int delimiter, const char *last) {
+        const auto first = recent[(piece_size - delimiter_length) % max_length];
+        if (piece_size == delimiter_length) {
+            tokens.push_back(token{filtered_string_view(""), delimiter});
+        } else {
+            tokens.push_back(token{subrange(fsv, piece, first), delimiter});
+        }
+        piece = last + 1;
+        piece_size = 0;
+    };
+
+    const auto &predicate = fsv.predicate();
+    const auto last = fsv.data() + fsv.length();
+    if (max_length == 1) {
+        auto table = std::array<int, 256>{};
+        table.fill(-1);
+        for (auto i = static_cast<int>(patterns.size()) - 1; i >= 0; --i) {
+            if (patterns[static_cast<std::size_t>(i)].size() == 1) {
+                table[static_cast<unsigned char>(patterns[static_cast<std::size_t>(i)][0])] = i;
+            }
+        }
+        for (auto c = fsv.data(); c != last; ++c) {
+            if (predicate(*c)) {
+                recent[0] = c;
+                ++piece_size;
+                if (const auto delimiter = table[static_cast<unsigned char>(*c)]; delimiter != -1) {
+                    add_token(1, delimiter, c);
+                }
+            }
+        }
+    } else {
+        const auto automaton = delimiter_automaton(patterns);
+        auto node = 0;
+        for (auto c = fsv.data(); c != last; ++c) {
+            if (predicate(*c)) {
+                recent[piece_size % max_length] = c;
+                ++piece_size;
+                node = automaton.next(node, *c);
+                if (const auto delimiter = automaton.match(node); delimiter != delimiter_automaton::no_match) {
+                    add_token(patterns[static_cast<std::size_t>(delimiter)].size(), delimiter, c);
+                    node = 0;
+                }
+            }
+        }
+    }
+    // The final piece is ended by the end of fsv rather than a delimiter
+    if (piece_size == 0) {
+        tokens.push_back(token{filtered_string_view(""), -1});
+    } else {
+        tokens.push_back(token{subrange(fsv, piece, last), -1});
+    }
+    return tokens;
+}
+
+fsv::incremental_filtered_string_view::incremental_filtered_string_view(const filter &predicate, const filtered_string_view &tok):
+data_{nullptr}, predicate_{predicate}, index_{std::make_shared<match_index>()}, tok_{static_cast<std::string>(tok)},
+tok_pos_{0}, piece_start_{0}, piece_size_{0} {
+    kmp_failure(tok_, tok_failure_);
+}
+
+fsv::incremental_filtered_string_view::incremental_filtered_string_view(const incremental_filtered_string_view &other):
+data_{other.data_}, predicate_{other.predicate_}, index_{std::make_shared<match_index>(*other.index_)}, tok_{other.tok_},
+tok_failure_{other.tok_failure_}, tok_pos_{other.tok_pos_}, piece_start_{other.piece_start_},
+piece_size_{other.piece_size_}, pieces_{other.pieces_} {}
+
+fsv::incremental_filtered_string_view::incremental_filtered_string_view(incremental_filtered_string_view &&other):
+data_{std::exchange(other.data_, nullptr)},
+predicate_{std::exchange(other.predicate_, filtered_string_view::default_predicate)},
+index_{std::exchange(other.index_, std::make_shared<match_index>())}, tok_{std::exchange(other.tok_, std::string{})},
+tok_failure_{std::exchange(other.tok_failure_, std::vector<std::size_t>{})}, tok_pos_{std::exchange(other.tok_pos_, 0)},
+piece_start_{std::exchange(other.piece_start_, 0)}, piece_size_{std::exchange(other.piece_size_, 0)},
+pieces_{std::exchange(other.pieces_, {})} {}
+
+auto fsv::incremental_filtered_string_view::operator=(const incremental_filtered_string_view &other)
+-> incremental_filtered_string_view& {
+    if (this != &other) {
+        *this = incremental_filtered_string_view(other);
+    }
+    return *this;
+}
+
+auto fsv::incremental_filtered_string_view::operator=(incremental_filtered_string_view &&other)
+-> incremental_filtered_string_view& {
+    if (this != &other) {
+        // Allocated first, so that neither object is changed if it throws
+        auto index = std::make_shared<match_index>();
+        data_ = std::exchange(other.data_, nullptr);
+        predicate_ = std::exchange(other.predicate_, filtered_string_view::default_predicate);
+        index_ = std::exchange(other.index_, std::move(index));
+        tok_ = std::exchange(other.tok_, std::string{});
+        tok_failure_ = std::exchange(other.tok_failure_, std::vector<std::size_t>{});
+        tok_pos_ = std::exchange(other.tok_pos_, 0);
+        piece_start_ = std::exchange(other.piece_start_, 0);
+        piece_size_ = std::exchange(other.piece_size_, 0);
+        pieces_ = std::exchange(other.pieces_, {});
+    }
+    return *this;
+}
+
+auto fsv::incremental_filtered_string_view::refresh(const char *data, std::size_t length) -> void {
+    data_ = data;
+    const auto old_length = index_->length();
+    if (length <= old_length) {
+        return;
+    }
+    index_->append(data_ + old_length, data_ + length, predicate_);
+    if (tok_.empty()) {
+        return;
+    }
+    // Continue matching tok from where the last refresh left off, using the same matching as split(). The index
+    // already knows which of the new characters are filtered, so the predicate is not called again
+    for (auto i = old_length; i < length; ++i) {
+        if (!index_->test(i)) {
+            continue;
+        }
+        ++piece_size_;
+        tok_pos_ = kmp_advance(tok_, tok_failure_, tok_pos_, data_[i]);
+        if (tok_pos_ == tok_.size()) {
+            if (piece_size_ == tok_.size()) {
+                pieces_.emplace_back(0, 0);
+            } else {
+                // The delimiter is the last tok_.size() filtered characters, so the index finds where it starts
+                pieces_.emplace_back(piece_start_, index_->select(index_->rank(i) + 1 - tok_.size()));
+            }
+            piece_start_ = i + 1;
+            piece_size_ = 0;
+            tok_pos_ = 0;
+        }
+    }
+}
+
+auto fsv::incremental_filtered_string_view::view() const -> filtered_string_view {
+    if (data_ == nullptr) {
+        return filtered_string_view{};
+    }
+    auto view = filtered_string_view(data_, index_->length(), predicate_);
+    view.index_ = index_;
+    return view;
+}
+
+auto fsv::incremental_filtered_string_view::take_pieces() -> std::vector<filtered_string_view> {
+    auto pieces = std::vector<filtered_string_view>{};
+    pieces.reserve(pieces_.size());
+    for (const auto &[first, last] : pieces_) {
+        pieces.push_back(piece(first, last));
+    }
+    pieces_.clear();
+    return pieces;
+}
+
+auto fsv::incremental_filtered_string_view::pending() const -> filtered_string_view {
+    // Without a delimiter nothing is ever split off, as with split()
+    if (tok_.empty()) {
+        return view();
+    }
+    return piece_size_ == 0 ? filtered_string_view("") : piece(piece_start_, index_->length());
+}
+
+auto fsv::incremental_filtered_string_view::piece(std::size_t first, std::size_t last) const -> filtered_string_view {
+    return first == last ? filtered_string_view("") : subrange(predicate_, data_ + first, data_ + last);
+}
+
+auto fsv::detail::filtered_range(const filtered_string_view &fsv, char *buffer, std::size_t size, const char *&first,
+                                 const char *&last) noexcept -> bool {
+    const auto &predicate = fsv.predicate();
+    const auto end = fsv.data() + fsv.length();
+    const char *start = nullptr;
+    const char *previous = nullptr;
+    auto contiguous = true;
+    auto truncated = false;
+    auto count = std::size_t{0};
+    // Copy while scanning so that a single pass suffices whichever way the characters are laid out
+    for (auto c = fsv.data(); c != end; ++c) {
+        if (!predicate(*c)) {
+            continue;
+        }
+        if (start == nullptr) {
+            start = c;
+        } else if (c != previous + 1) {
+            // A contiguous run too long for buffer can only be parsed in place, so the prefix ends with it
+            if (count > size) {
+                truncated = true;
+                break;
+            }
+            contiguous = false;
+        }
+        if (!contiguous && count == size) {
+            truncated = true;
+            break;
+        }
+        if (count < size) {
+            buffer[count] = *c;
+        }
+        previous = c;
+        ++count;
+    }
+    if (start != nullptr && contiguous) {
+        first = start;
+        last = previous + 1;
+        return truncated;
+    }
+    first = buffer;
+    last = buffer + std::min(count, size);
+    return truncated;
+}
+
+fsv::transformed_string_view::operator std::string() const {
+    auto string = std::string{};
+    // Without an index, size() would be a pass of its own
+    if (fsv_.has_index()) {
+        string.reserve(size());
+    }
+    visit_transformed(*this, [&string](const char c) { string += c; });
+    return string;
+}
+
+auto fsv::operator<=>(const transformed_string_view &lhs, const transformed_string_view &rhs) -> std::strong_ordering {
+    const auto &lpredicate = lhs.fsv_.predicate();
+    const auto &rpredicate = rhs.fsv_.predicate();
+    auto l = lhs.fsv_.data();
+    auto r = rhs.fsv_.data();
+    const auto lend = l + lhs.fsv_.length();
+    const auto rend = r + rhs.fsv_.length();
+    while (true) {
+        while (l != lend && !lpredicate(*l)) {
+            ++l;
+        }
+        while (r != rend && !rpredicate(*r)) {
+            ++r;
+        }
+        if (l == lend || r == rend) {
+            if (l == lend && r == rend) {
+                return std::strong_ordering::equal;
+            }
+            return l == lend ? std::strong_ordering::less : std::strong_ordering::greater;
+        }
+        const auto lc = lhs.apply(*l);
+        const auto rc = rhs.apply(*r);
+        if (lc != rc) {
+            return lc <=> rc;
+        }
+        ++l;
+        ++r;
+    }
+}
+
+auto fsv::operator<<(std::ostream &os, const transformed_string_view &tsv) -> std::ostream& {
+    visit_transformed(tsv, [&os](const char c) { os << c; });
+    return os;
+}
+
+auto std::hash<fsv::transformed_string_view>::operator()(const fsv::transformed_string_view &tsv) const -> std::size_t {
+    auto hash = fnv_offset_basis;
+    visit_transformed(tsv, [&hash](const char c) { hash = fnv1a(hash, c); });
+    return static_cast<std::size_t>(hash);
+}
+
+fsv::filtered_string_rope::filtered_string_rope(std::initializer_list<filtered_string_view> fragments) {
+    fragments_.reserve(fragments.size());
+    offsets_.reserve(fragments.size());
+    for (const auto &fragment : fragments) {
+        push_back(fragment);
+    }
+}
+
+auto fsv::filtered_string_rope::push_back(const filtered_string_view &fragment) -> void {
+    // Indexing costs the same single predicate pass that counting the fragment would, and makes lookups within it
+    // a select rather than a scan
+    fragments_.push_back(fragment);
+    if (!fragments_.back().has_index()) {
+        fragments_.back().build_index();
+    }
+    offsets_.push_back(size() + fragments_.back().size());
+}
+
+auto fsv::filtered_string_rope::operator[](std::size_t n) const noexcept -> const char& {
+    // The first fragment whose running size exceeds n holds the character
+    const auto fragment = static_cast<std::size_t>(std::upper_bound(offsets_.begin(), offsets_.end(), n) - offsets_.begin());
+    const auto before = fragment == 0 ? 0 : offsets_[fragment - 1];
+    return fragments_[fragment][static_cast<int>(n - before)];
+}
+
+fsv::filtered_string_rope::operator std::string() const {
+    auto string = std::string(size(), '\0');
+    auto out = string.begin();
+    for (const auto &fragment : fragments_) {
+        visit_filtered(fragment, [&out](const char c) { *out++ = c; });
+    }
+    return string;
+}
+
+auto fsv::filtered_string_rope::next_fragment(std::size_t fragment) const noexcept -> std::size_t {
+    while (fragment < fragments_.size() && fragment_size(fragment) == 0) {
+        ++fragment;
+    }
+    return fragment;
+}
+
+auto fsv::filtered_string_rope::prev_fragment(std::size_t fragment) const noexcept -> std::size_t {
+    do {
+        --fragment;
+    } while (fragment_size(fragment) == 0);
+    return fragment;
+}
+
+auto fsv::operator<<(std::ostream &os, const filtered_string_rope &rope) -> std::ostream& {
+    for (const auto &fragment : rope.fragments()) {
+        visit_filtered(fragment, [&os](const char c) { os << c; });
+    }
+    return os;
+}
+
+auto std::hash<fsv::filtered_string_view>::operator()(const fsv::filtered_string_view &fsv) const -> std::size_t {
+    auto hash = fnv_offset_basis;
+    visit_filtered(fsv, [&hash](const char c) { hash = fnv1a(hash, c); });
+    return static_cast<std::size_t>(hash);
+}
+
+auto std::hash<fsv::filtered_string_rope>::operator()(const fsv::filtered_string_rope &rope) const -> std::size_t {
+    auto hash = fnv_offset_basis;
+    for (const auto &fragment : rope.fragments()) {
+        visit_filtered(fragment, [&hash](const char c) { hash = fnv1a(hash, c); });
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+auto fsv::parallel_split(const filtered_string_view &fsv, const filtered_string_view &tok, unsigned threads)
+-> std::vector<filtered_string_view> {
+    if (tok.size() == 0) {
+        return std::vector<filtered_string_view>{fsv};
+    }
+    const auto delimiter = static_cast<std::string>(tok);
+    auto failure = std::vector<std::size_t>{};
+    kmp_failure(delimiter, failure);
+    const auto length = fsv.length();
+    const auto chunks = std::clamp(length / parallel_split_min_chunk, std::size_t{1}, std::size_t{std::max(threads, 1u)});
+    const auto chunk_length = length / chunks;
+
+    // Scan every chunk concurrently as though no delimiter were partially matched at its start
+    auto futures = std::vector<std::future<chunk_scan>>{};
+    auto bounds = std::vector<std::size_t>{0};
+    for (auto i = std::size_t{0}; i < chunks; ++i) {
+        bounds.push_back(i + 1 == chunks ? length : bounds.back() + chunk_length);
+        futures.push_back(std::async(std::launch::async, scan_chunk, std::cref(fsv), std::cref(delimiter), std::cref(failure), bounds[i], bounds[i + 1]));
+    }
+
+    // Stitch the chunks together in order. Where a delimiter was partially matched at the end of the previous chunk,
+    // rescan from that state until it agrees with the chunk's own scan, replacing any delimiters found before then
+    const auto &predicate = fsv.predicate();
+    auto matches = std::vector<delimiter_match>{};
+    auto state = delimiter_matcher(delimiter, failure);
+    auto base = std::size_t{0};
+    for (auto i = std::size_t{0}; i < chunks; ++i) {
+        auto scan = futures[i].get();
+        for (auto &match : scan.matches) {
+            match.index += base;
+        }
+        auto resume = bounds[i]; // Offset from which the chunk's own matches are valid
+        if (state.matching()) {
+            auto fresh = delimiter_matcher(delimiter, failure);
+            auto index = base;
+            auto converged = false;
+            for (auto offset = bounds[i]; offset != bounds[i + 1] && !converged; ++offset) {
+                const auto c = fsv.data()[offset];
+                if (!predicate(c)) {
+                    continue;
+                }
+                fresh.step(c, offset, index);
+                if (state.step(c, offset, index)) {
+                    matches.push_back(state.match(offset));
+                }
+                ++index;
+                converged = state == fresh;
+                resume = offset + 1;
+            }
+            if (!converged) {
+                base += scan.count;
+                continue;
+            }
+        }
+        for (const auto &match : scan.matches) {
+            if (match.last > resume) {
+                matches.push_back(match);
+            }
+        }
+        state = scan.matcher;
+        base += scan.count;
+    }
+
+    // Turn the delimiters into the pieces between them, as split does
+    auto split_strings = std::vector<filtered_string_view>{};
+    split_strings.reserve(matches.size() + 1);
+    auto piece = std::size_t{0};
+    auto piece_index = std::size_t{0};
+    const auto add_piece = [&](std::size_t last, std::size_t last_index) {
+        if (last_index == piece_index) {
+            split_strings.push_back(filtered_string_view(""));
+        } else {
+            split_strings.push_back(subrange(fsv, fsv.data() + piece, fsv.data() + last));
+        }
+    };
+    for (const auto &match : matches) {
+        add_piece(match.first, match.index);
+        piece = match.last;
+        piece_index = match.index + delimiter.size();
+    }
+    add_piece(length, base);
+    return split_strings;
+}
+
+auto fsv::sort_views(std::vector<filtered_string_view> &views) -> void {
+    auto keys = make_sort_keys(views);
+    std::sort(keys.begin(), keys.end(), [&views](const sort_key &lhs, const sort_key &rhs) {
+        const auto order = lhs.compare(rhs);
+        if (order != std::strong_ordering::equal || !lhs.truncated()) {
+            return order == std::strong_ordering::less;
+        }
+        return views[lhs.index] < views[rhs.index];
+    });
+    auto sorted = std::vector<filtered_string_view>{};
+    sorted.reserve(views.size());
+    for (const auto &key : keys) {
+        sorted.push_back(std::move(views[key.index]));
+    }
+    views = std::move(sorted);
+}
+
+auto fsv::unique_views(std::vector<filtered_string_view> &views) -> std::vector<filtered_string_view>::iterator {
+    if (views.empty()) {
+        return views.end();
+    }
+    const auto keys = make_sort_keys(views);
+    auto kept = std::size_t{0};
+    auto previous = keys.begin(); // Key of the last view kept
+    for (auto i = std::size_t{1}; i < views.size(); ++i) {
+        // Equal keys of 1 to 15 characters hold the whole of both views. Otherwise operator== decides, as it also
+        // distinguishes a default constructed view from an empty one
+        const auto &key = keys[i];
+        const auto same_key = key.compare(*previous) == std::strong_ordering::equal;
+        const auto equal = same_key && ((key.length != 0 && !key.truncated()) || views[i] == views[kept]);
+        if (!equal) {
+            ++kept;
+            if (kept != i) {
+                views[kept] = std::move(views[i]);
+            }
+            previous = keys.begin() + static_cast<std::ptrdiff_t>(i);
+        }
+    }
+    return views.begin() + static_cast<std::ptrdiff_t>(kept + 1);
+}
+
+template <typename Matches>
+auto fsv::intern_pool::probe(std::size_t hash, Matches matches) const -> std::size_t {
+    const auto mask = slots_.size() - 1;
+    for (auto slot = hash & mask;; slot = (slot + 1) & mask) {
+        const auto entry = slots_[slot];
+        if (entry == 0 || (hashes_[entry - 1] == hash && matches((*this)[entry - 1]))) {
+            return slot;
+        }
+    }
+}
+
+auto fsv::intern_pool::grow() -> void {
+    slots_.assign(std::max(slots_.size() * 2, std::size_t{16}), 0);
+    const auto mask = slots_.size() - 1;
+    for (auto i = std::size_t{0}; i < hashes_.size(); ++i) {
+        auto slot = hashes_[i] & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<id>(i + 1);
+    }
+}
+
+auto fsv::intern_pool::intern(const filtered_string_view &fsv) -> id {
+    if ((hashes_.size() + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    // Probe with fsv compared in place, so that a string already in the pool leaves the arena untouched and the
+    // characters are only copied into it for a new string
+    const auto hash = std::hash<filtered_string_view>{}(fsv);
+    const auto slot = probe(hash, [&fsv](std::string_view other) { return filtered_equals(fsv, other); });
+    if (slots_[slot] != 0) {
+        return slots_[slot] - 1;
+    }
+    visit_filtered(fsv, [this](const char c) { arena_ += c; });
+    const auto i = static_cast<id>(hashes_.size());
+    hashes_.push_back(hash);
+    offsets_.push_back(arena_.size());
+    slots_[slot] = i + 1;
+    return i;
+}
+
+auto fsv::intern_pool::find(const filtered_string_view &fsv) const -> std::optional<id> {
+    if (slots_.empty()) {
+        return std::nullopt;
+    }
+    const auto hash = std::hash<filtered_string_view>{}(fsv);
+    const auto slot = probe(hash, [&fsv](std::string_view other) { return filtered_equals(fsv, other); });
+    return slots_[slot] == 0 ? std::nullopt : std::optional<id>(slots_[slot] - 1);
+}
+
+auto fsv::chunks(filtered_string_view fsv, std::size_t chunk_size) -> generator<std::string_view> {
+    auto buffer = std::string(std::max(chunk_size, std::size_t{1}), '\0');
+    auto size = std::size_t{0};
+    const auto &predicate = fsv.predicate();
+    const auto last = fsv.data() + fsv.length();
+    for (auto c = fsv.data(); c != last; ++c) {
+        if (predicate(*c)) {
+            buffer[size] = *c;
+            if (++size == buffer.size()) {
+                co_yield std::string_view(buffer);
+                size = 0;
+            }
+        }
+    }
+    if (size != 0) {
+        co_yield std::string_view(buffer).substr(0, size);
+    }
+}
+
+auto fsv::lazy_split(filtered_string_view fsv, filtered_string_view tok) -> generator<filtered_string_view> {
+    if (tok.size() == 0) {
+        co_yield fsv;
+        co_return;
+    }
+    const auto delimiter = static_cast<std::string>(tok);
+    auto failure = std::vector<std::size_t>{};
+    kmp_failure(delimiter, failure);
+    auto matcher = delimiter_matcher(delimiter, failure);
+    auto piece = std::size_t{0}; // Offset at which the current piece starts
+    auto piece_size = std::size_t{0}; // Filtered characters seen since the start of the current piece
+    const auto &predicate = fsv.predicate();
+    for (auto offset = std::size_t{0}; offset != fsv.length(); ++offset) {
+        const auto c = fsv.data()[offset];
+        if (!predicate(c)) {
+            continue;
+        }
+        ++piece_size;
+        if (matcher.step(c, offset, 0)) {
+            const auto match = matcher.match(offset);
+            if (piece_size == delimiter.size()) {
+                co_yield filtered_string_view("");
+            } else {
+                co_yield subrange(fsv, fsv.data() + piece, fsv.data() + match.first);
+            }
+            piece = match.last;
+            piece_size = 0;
+        }
+    }
+    if (piece_size == 0) {
+        co_yield filtered_string_view("");
+    } else {
+        co_yield subrange(fsv, fsv.data() + piece, fsv.data() + fsv.length());
+    }
+}
@@ -2,16 +2,78 @@
 #define COMP6771_ASS2_FSV_H
 
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <compare>
+#include <concepts>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <exception>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace fsv {
     using filter = std::function<bool(const char &)>;
+    using transform = std::function<char(const char &)>;
+    // A table driven transform maps each character c to table[static_cast<unsigned char>(c)]
+    using transform_table = std::array<char, 256>;
+
+    // Succinct rank/select index over an underlying string: one bit per character records whether it
+    // satisfies the predicate, and a running count of set bits is kept every 512 bits (8 words) so that
+    // rank and select queries never rescan the string. Overhead is ~1.125 bits per source character.
+    class match_index {
+    public:
+        match_index() noexcept = default;
+
+        match_index(const char *data, std::size_t length, const filter &predicate);
+
+        // Extends the index with the characters in [first, last), evaluating the predicate once per character
+        auto append(const char *first, const char *last, const filter &predicate) -> void;
+
+        // Number of characters covered by the index
+        auto length() const noexcept -> std::size_t {
+            return length_;
+        }
+
+        // Number of characters which satisfied the predicate
+        auto count() const noexcept -> std::size_t {
+            return count_;
+        }
+
+        auto test(std::size_t pos) const noexcept -> bool {
+            return (bits_[pos / word_bits] >> (pos % word_bits)) & 1u;
+        }
+
+        // Number of matching characters in [0, pos)
+        auto rank(std::size_t pos) const noexcept -> std::size_t;
+
+        // Position of the nth (0-indexed) matching character, or length() if there are not that many
+        auto select(std::size_t n) const noexcept -> std::size_t;
+
+    private:
+        static constexpr auto word_bits = std::size_t{64};
+        static constexpr auto block_words = std::size_t{8};
+        static constexpr auto block_bits = word_bits * block_words;
+
+        std::vector<std::uint64_t> bits_;
+        std::vector<std::uint64_t> ranks_; // ranks_[i] is the number of set bits before bit i * block_bits
+        std::size_t length_ = 0;
+        std::size_t count_ = 0;
+    };
+
     class filtered_string_view {
         template <typename ValueType>
         class iter {
@@ -38,7 +100,7 @@ namespace fsv {
                 if (index_ == size_) {
                     return *this;
                 }
-                while (!fsv_->predicate_(*pointer_)) {
+                while (!fsv_->matches(pointer_)) {
                     ++pointer_;
                 }
                 return *this;
@@ -52,7 +114,7 @@ namespace fsv {
 
             auto operator--() noexcept -> iter& {
                 pointer_--;
-                while (!fsv_->predicate_(*pointer_)) {
+                while (!fsv_->matches(pointer_)) {
                     pointer_--;
                 }
                 index_--;
@@ -89,7 +151,7 @@ namespace fsv {
         using reverse_iterator = std::reverse_iterator<iterator>;
         using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-        auto static default_predicate(const char &) noexcept -> bool {
+        constexpr auto static default_predicate(const char &) noexcept -> bool {
             return true;
         }
         
@@ -101,10 +163,15 @@ namespace fsv {
         filtered_string_view(const char *str, const filter &predicate = default_predicate) noexcept:
         data_{str}, length_{strlen(str)}, predicate_{predicate} {};
 
+        // Views only the first length characters of str, which need not be null terminated
+        filtered_string_view(const char *str, std::size_t length, const filter &predicate = default_predicate) noexcept:
+        data_{str}, length_{length}, predicate_{predicate} {}
+
         filtered_string_view(const filtered_string_view &other) noexcept = default;
 
         filtered_string_view(filtered_string_view &&other) noexcept : data_{std::exchange(other.data_, nullptr)}, 
-        length_{std::exchange(other.length_, 0)}, predicate_{std::exchange(other.predicate_, default_predicate)} {}
+        length_{std::exchange(other.length_, 0)}, predicate_{std::exchange(other.predicate_, default_predicate)},
+        index_{std::move(other.index_)} {}
 
         ~filtered_string_view() noexcept = default;
 
@@ -134,11 +201,13 @@ namespace fsv {
                 return std::strong_ordering::equivalent;
             }
 
-            // Iterating over the filtered string
+            // Iterating over the filtered string. end() is found once up front as it has to scan the string
             auto iter1 = lhs.begin();
             auto iter2 = rhs.begin();
+            const auto end1 = lhs.end();
+            const auto end2 = rhs.end();
 
-            while (iter1 != lhs.end() && iter2 != rhs.end()) {
+            while (iter1 != end1 && iter2 != end2) {
                 if (*iter1 != *iter2) {
                     return (*iter1 <=> *iter2);
                 }
@@ -147,9 +216,9 @@ namespace fsv {
             }
 
             // Comparing the lengths of the filtered strings if prior characters were equal
-            if (iter1 == lhs.end() && iter2 != rhs.end()) {
+            if (iter1 == end1 && iter2 != end2) {
                 return std::strong_ordering::less;
-            } else if (iter1 != lhs.end() && iter2 == rhs.end()) {
+            } else if (iter1 != end1 && iter2 == end2) {
                 return std::strong_ordering::greater;
             }
 
@@ -167,6 +236,11 @@ namespace fsv {
             return data_;
         }
 
+        // Number of underlying characters, including those rejected by the predicate
+        auto length() const noexcept -> std::size_t {
+            return length_;
+        }
+
         auto size() const noexcept -> std::size_t;
 
         auto predicate() const noexcept -> const filter& {
@@ -231,12 +305,28 @@ namespace fsv {
             return data_ == other->data_ && &predicate_ == &(other->predicate_);
         }
 
+        // Builds a rank/select index of the matching characters so that size(), operator[], and therefore
+        // substr() bounds and begin()/end(), no longer rescan the string. The index is shared by any copies
+        // made afterwards. Is not noexcept because the index is allocated on the heap
+        auto build_index() -> void;
+
+        auto has_index() const noexcept -> bool {
+            return index_ != nullptr;
+        }
+
     private:
         const char *data_;
         std::size_t length_;
         filter predicate_;
+        std::shared_ptr<const match_index> index_; // May cover more of the string than length_, but never less
+
+        friend class incremental_filtered_string_view;
 
         auto swap(filtered_string_view &other) noexcept -> void;
+
+        auto matches(const char *c) const noexcept -> bool {
+            return index_ ? index_->test(static_cast<std::size_t>(c - data_)) : predicate_(*c);
+        }
     };
 
     auto compose(const filtered_string_view &fsv, const std::vector<filter> &filts) noexcept -> filtered_string_view;
@@ -246,6 +336,894 @@ namespace fsv {
     auto split(const filtered_string_view &fsv, const filtered_string_view &tok) -> std::vector<filtered_string_view>;
     auto find_delimiter_positions(const filtered_string_view &fsv, const filtered_string_view &tok, std::vector<int> &delimiter_pos) -> void;
     auto substr(const filtered_string_view &fsv, int pos = 0, int count = 0) noexcept -> filtered_string_view;
+
+    // Sorts views into the same order as std::sort with operator<=>, but first compares a key packing the first 16
+    // filtered characters of each view, extracted in a single pass. Views are only compared character by character
+    // when their keys tie
+    auto sort_views(std::vector<filtered_string_view> &views) -> void;
+
+    // Removes consecutive equal views as std::unique with operator== does, returning the new end of views. Views whose
+    // keys differ are known to be unequal without comparing them character by character
+    auto unique_views(std::vector<filtered_string_view> &views) -> std::vector<filtered_string_view>::iterator;
+
+    // Chunks of the underlying string smaller than this are not worth a thread of their own
+    inline constexpr auto parallel_split_min_chunk = std::size_t{4096};
+
+    // Produces exactly what split() does, but scans chunks of the underlying string on separate threads and then
+    // repairs any delimiters which straddle chunk boundaries. The predicate of fsv is called concurrently, so it must
+    // be safe to call from several threads at once
+    auto parallel_split(const filtered_string_view &fsv, const filtered_string_view &tok,
+                        unsigned threads = std::thread::hardware_concurrency()) -> std::vector<filtered_string_view>;
+
+    // Allocator-aware overloads: the containers returned or filled, and split's working storage, are allocated from
+    // resource, so a whole request's parsing can be carved from e.g. a std::pmr::monotonic_buffer_resource and
+    // released at once. Views still hold a std::function, which allocates on the global heap whenever its callable is
+    // too large to store inline. Each piece of split copies the predicate of fsv, so it allocates only if that
+    // predicate does. compose keeps its copy of filts in resource, shared by every copy of the view it returns, but
+    // the predicate wrapping it is allocated on the global heap, once per copy of the view
+    auto compose(const filtered_string_view &fsv, const std::vector<filter> &filts, std::pmr::memory_resource *resource) -> filtered_string_view;
+    auto split(const filtered_string_view &fsv, const filtered_string_view &tok, std::pmr::memory_resource *resource) -> std::pmr::vector<filtered_string_view>;
+    auto find_delimiter_positions(const filtered_string_view &fsv, const filtered_string_view &tok, std::pmr::vector<int> &delimiter_pos) -> void;
+    auto to_string(const filtered_string_view &fsv, std::pmr::memory_resource *resource) -> std::pmr::string;
+
+    // A piece of a tokenized view together with the delimiter which ended it
+    struct token {
+        filtered_string_view view;
+        int delimiter; // Index of the delimiter in the list given to tokenize, or -1 for the final piece
+    };
+
+    // Splits fsv on any of delimiters in a single pass over its filtered characters. Multi-character delimiters are
+    // compiled into an Aho-Corasick automaton, and a byte lookup table is used when every delimiter is a single
+    // character. A delimiter is taken as soon as it is complete; if several complete on the same character, the
+    // longest wins. Empty delimiters are ignored, and with no delimiters the result is fsv as a single token. Each
+    // token views only its own characters of fsv, so the tokens together cost one more pass to read
+    auto tokenize(const filtered_string_view &fsv, const std::vector<filtered_string_view> &delimiters) -> std::vector<token>;
+
+    template <typename... Delimiters>
+    requires (std::convertible_to<const Delimiters&, filtered_string_view> && ...)
+    auto tokenize(const filtered_string_view &fsv, const Delimiters &...delimiters) -> std::vector<token> {
+        return tokenize(fsv, std::vector<filtered_string_view>{filtered_string_view(delimiters)...});
+    }
+
+    // Result of parsing a number straight from a filtered_string_view
+    struct from_chars_result {
+        std::size_t count; // Number of filtered characters which made up the number
+        std::errc ec;
+    };
+
+    namespace detail {
+        // Filtered characters are copied into a buffer of this size on the stack when they are not contiguous
+        inline constexpr auto from_chars_buffer_size = std::size_t{128};
+
+        // Sets [first, last) to a prefix of the filtered characters of fsv, scanning no further than it needs to. A
+        // contiguous run at the start of the underlying string is used in place, however long. Otherwise up to size
+        // characters are copied into buffer. Returns true if further filtered characters follow the prefix
+        auto filtered_range(const filtered_string_view &fsv, char *buffer, std::size_t size, const char *&first,
+                            const char *&last) noexcept -> bool;
+    }
+
+    // Parses an integer from fsv as std::from_chars does, without materialising it: the characters are read in place
+    // when they are contiguous in the underlying string and otherwise from a small stack buffer. Only a number which
+    // runs on past detail::from_chars_buffer_size scattered characters fails with std::errc::value_too_large
+    template <typename T>
+    requires std::integral<T> && (!std::same_as<T, bool>)
+    auto from_chars(const filtered_string_view &fsv, T &value, int base = 10) noexcept -> from_chars_result {
+        auto buffer = std::array<char, detail::from_chars_buffer_size>{};
+        const char *first = buffer.data();
+        auto last = first;
+        const auto truncated = detail::filtered_range(fsv, buffer.data(), buffer.size(), first, last);
+        const auto result = std::from_chars(first, last, value, base);
+        if (truncated && result.ptr == last) {
+            return from_chars_result{0, std::errc::value_too_large};
+        }
+        return from_chars_result{static_cast<std::size_t>(result.ptr - first), result.ec};
+    }
+
+    template <std::floating_point T>
+    auto from_chars(const filtered_string_view &fsv, T &value, std::chars_format fmt = std::chars_format::general) noexcept
+    -> from_chars_result {
+        auto buffer = std::array<char, detail::from_chars_buffer_size>{};
+        const char *first = buffer.data();
+        auto last = first;
+        const auto truncated = detail::filtered_range(fsv, buffer.data(), buffer.size(), first, last);
+        const auto result = std::from_chars(first, last, value, fmt);
+        if (truncated && result.ptr == last) {
+            return from_chars_result{0, std::errc::value_too_large};
+        }
+        return from_chars_result{static_cast<std::size_t>(result.ptr - first), result.ec};
+    }
+
+    // A filtered view over a buffer which is only ever appended to, such as a log being tailed. Each refresh() only
+    // examines the newly appended characters, extending a rank/select index of the matches and the state of a pending
+    // split on tok, so that size() and operator[] stay O(1) rather than rescanning the whole buffer
+    class incremental_filtered_string_view {
+    public:
+        explicit incremental_filtered_string_view(const filter &predicate = filtered_string_view::default_predicate,
+                                                  const filtered_string_view &tok = filtered_string_view{});
+
+        // A copy has an index of its own, since views taken from the original share the original's
+        incremental_filtered_string_view(const incremental_filtered_string_view &other);
+
+        // Leaves other empty but usable. Is not noexcept because other is given a fresh index on the heap
+        incremental_filtered_string_view(incremental_filtered_string_view &&other);
+
+        auto operator=(const incremental_filtered_string_view &other) -> incremental_filtered_string_view&;
+
+        auto operator=(incremental_filtered_string_view &&other) -> incremental_filtered_string_view&;
+
+        // Extends the view to cover the first length characters of data. data may differ from the previous refresh if
+        // the buffer has moved, but the characters already seen must be unchanged
+        auto refresh(const char *data, std::size_t length) -> void;
+
+        auto refresh(const std::string &buffer) -> void {
+            refresh(buffer.data(), buffer.size());
+        }
+
+        // Precondition: 0 <= n < size()
+        auto operator[](int n) const noexcept -> const char& {
+            return data_[index_->select(static_cast<std::size_t>(n))];
+        }
+
+        auto size() const noexcept -> std::size_t {
+            return index_->count();
+        }
+
+        auto length() const noexcept -> std::size_t {
+            return index_->length();
+        }
+
+        auto empty() const noexcept -> bool {
+            return size() == 0;
+        }
+
+        auto data() const noexcept -> const char* {
+            return data_;
+        }
+
+        // A filtered_string_view of the buffer as of the last refresh. It shares the index, so its size() and
+        // operator[] stay O(1), and later refreshes do not change it. It must not be used while refresh() runs
+        auto view() const -> filtered_string_view;
+
+        // The pieces ended by tok since the last call, as split() would produce them. They stay valid until the buffer
+        // moves
+        auto take_pieces() -> std::vector<filtered_string_view>;
+
+        // The trailing piece which has not yet been ended by tok
+        auto pending() const -> filtered_string_view;
+
+    private:
+        const char *data_;
+        filter predicate_;
+        std::shared_ptr<match_index> index_; // Only ever appended to, so views of a shorter prefix may share it
+        std::string tok_;
+        std::vector<std::size_t> tok_failure_; // Where a partial match of tok falls back to on a mismatch
+        // Split state, as offsets into the buffer so that it survives the buffer moving
+        std::size_t tok_pos_; // Number of characters of tok matched so far
+        std::size_t piece_start_; // Offset at which the pending piece starts
+        std::size_t piece_size_; // Filtered characters seen since piece_start_
+        std::vector<std::pair<std::size_t, std::size_t>> pieces_; // Completed pieces as [first, last) offsets,
+                                                                 // or {0, 0} for an empty piece
+
+        auto piece(std::size_t first, std::size_t last) const -> filtered_string_view;
+    };
+
+    // Stores each distinct filtered string once in a contiguous arena and identifies it by a small id, so that equality
+    // of interned strings is an integer comparison. Views are hashed and compared on their filtered characters
+    // directly, without being materialised
+    class intern_pool {
+    public:
+        using id = std::uint32_t;
+
+        intern_pool() = default;
+
+        // The id of the filtered string of fsv, which is added to the pool if it is not already there
+        auto intern(const filtered_string_view &fsv) -> id;
+
+        auto find(const filtered_string_view &fsv) const -> std::optional<id>;
+
+        // The string with the given id. It stays valid until intern next adds a new string
+        auto operator[](id i) const noexcept -> std::string_view {
+            return std::string_view(arena_).substr(offsets_[i], offsets_[i + 1] - offsets_[i]);
+        }
+
+        // Number of distinct strings in the pool
+        auto size() const noexcept -> std::size_t {
+            return hashes_.size();
+        }
+
+    private:
+        std::string arena_;
+        std::vector<std::size_t> offsets_{0}; // String i occupies [offsets_[i], offsets_[i + 1]) of arena_
+        std::vector<std::size_t> hashes_; // Hash of string i, kept so that growing the table does not rehash
+        std::vector<id> slots_; // Open addressed hash table of id + 1, with 0 for an empty slot
+
+        // Index of the slot holding the string equal to matches, or of the empty slot where it would go
+        template <typename Matches>
+        auto probe(std::size_t hash, Matches matches) const -> std::size_t;
+
+        auto grow() -> void;
+    };
+
+    // A filtered_string_view whose characters are mapped through a transform as they are read, so that filtering and
+    // e.g. lowercasing happen together in a single pass instead of materialising the filtered string first
+    class transformed_string_view {
+        class iter {
+        friend transformed_string_view;
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char;
+            using reference_type = const value_type&;
+            using pointer_type = void;
+            using difference_type = std::ptrdiff_t;
+
+            iter() noexcept = default;
+
+            auto operator*() const -> char {
+                return tsv_->apply(*iter_);
+            }
+
+            auto operator++() noexcept -> iter& {
+                ++iter_;
+                return *this;
+            }
+
+            auto operator++(int) noexcept -> iter {
+                auto self = *this;
+                ++*this;
+                return self;
+            }
+
+            auto operator--() noexcept -> iter& {
+                --iter_;
+                return *this;
+            }
+
+            auto operator--(int) noexcept -> iter {
+                auto self = *this;
+                --*this;
+                return self;
+            }
+
+            friend auto operator==(const iter &lhs, const iter &rhs) noexcept -> bool {
+                return lhs.iter_ == rhs.iter_;
+            }
+
+        private:
+            iter(const transformed_string_view *tsv, filtered_string_view::const_iterator iter) noexcept:
+            tsv_{tsv}, iter_{iter} {}
+
+            const transformed_string_view *tsv_; // Pointer to the container being iterated over
+            filtered_string_view::const_iterator iter_; // Position in the underlying filtered_string_view
+        };
+
+    public:
+        using const_iterator = iter;
+        using iterator = const_iterator;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        transformed_string_view(const filtered_string_view &fsv, const transform &fn):
+        fsv_{fsv}, transform_{fn} {}
+
+        // The table is shared by copies of the view rather than being copied with it
+        transformed_string_view(const filtered_string_view &fsv, const transform_table &table):
+        fsv_{fsv}, table_{std::make_shared<const transform_table>(table)} {}
+
+        auto operator[](int n) const -> char {
+            return apply(fsv_[n]);
+        }
+
+        // Filters and transforms in a single pass over the underlying string. The result is only reserved up front
+        // when the view is indexed, since counting it would otherwise take a second pass
+        explicit operator std::string() const;
+
+        auto friend operator==(const transformed_string_view &lhs, const transformed_string_view &rhs) -> bool {
+            return (lhs <=> rhs) == std::strong_ordering::equal;
+        }
+
+        // Walks both underlying strings directly, applying each predicate and transform once per character
+        auto friend operator<=>(const transformed_string_view &lhs, const transformed_string_view &rhs) -> std::strong_ordering;
+
+        auto friend operator<<(std::ostream &os, const transformed_string_view &tsv) -> std::ostream&;
+
+        auto view() const noexcept -> const filtered_string_view& {
+            return fsv_;
+        }
+
+        auto size() const noexcept -> std::size_t {
+            return fsv_.size();
+        }
+
+        auto empty() const noexcept -> bool {
+            return fsv_.empty();
+        }
+
+        auto begin() const noexcept -> const_iterator {
+            return const_iterator(this, fsv_.begin());
+        }
+
+        auto end() const noexcept -> const_iterator {
+            return const_iterator(this, fsv_.end());
+        }
+
+        auto rbegin() const noexcept -> const_reverse_iterator {
+            return const_reverse_iterator{end()};
+        }
+
+        auto rend() const noexcept -> const_reverse_iterator {
+            return const_reverse_iterator{begin()};
+        }
+
+        auto apply(const char &c) const -> char {
+            return table_ ? (*table_)[static_cast<unsigned char>(c)] : transform_(c);
+        }
+
+    private:
+        filtered_string_view fsv_;
+        transform transform_;
+        std::shared_ptr<const transform_table> table_;
+    };
+
+    auto operator<=>(const transformed_string_view &lhs, const transformed_string_view &rhs) -> std::strong_ordering;
+    auto operator<<(std::ostream &os, const transformed_string_view &tsv) -> std::ostream&;
+
+    // An ordered sequence of filtered_string_views read as one string without copying any characters. Each fragment
+    // is given a rank/select index and its size cached when it is appended, so indexing is a binary search over the
+    // running sizes followed by a select within a single fragment, O(log k + log n) in all
+    class filtered_string_rope {
+        class iter {
+        friend filtered_string_rope;
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char;
+            using reference_type = const value_type&;
+            using pointer_type = void;
+            using difference_type = std::ptrdiff_t;
+
+            iter() noexcept = default;
+
+            auto operator*() const noexcept -> char {
+                return *iter_;
+            }
+
+            auto operator++() noexcept -> iter& {
+                ++pos_;
+                // Move on to the next non-empty fragment once this one is exhausted
+                if (pos_ == rope_->fragment_size(fragment_)) {
+                    fragment_ = rope_->next_fragment(fragment_ + 1);
+                    pos_ = 0;
+                    if (fragment_ != rope_->fragments_.size()) {
+                        iter_ = rope_->fragments_[fragment_].begin();
+                    }
+                } else {
+                    ++iter_;
+                }
+                return *this;
+            }
+
+            auto operator++(int) noexcept -> iter {
+                auto self = *this;
+                ++*this;
+                return self;
+            }
+
+            auto operator--() noexcept -> iter& {
+                if (pos_ == 0) {
+                    fragment_ = rope_->prev_fragment(fragment_);
+                    pos_ = rope_->fragment_size(fragment_);
+                    iter_ = rope_->fragments_[fragment_].end();
+                }
+                --pos_;
+                --iter_;
+                return *this;
+            }
+
+            auto operator--(int) noexcept -> iter {
+                auto self = *this;
+                --*this;
+                return self;
+            }
+
+            friend auto operator==(const iter &lhs, const iter &rhs) noexcept -> bool {
+                return lhs.fragment_ == rhs.fragment_ && lhs.pos_ == rhs.pos_;
+            }
+
+        private:
+            iter(const filtered_string_rope *rope, std::size_t fragment) noexcept:
+            rope_{rope}, fragment_{fragment}, pos_{0} {
+                if (fragment_ != rope_->fragments_.size()) {
+                    iter_ = rope_->fragments_[fragment_].begin();
+                }
+            }
+
+            const filtered_string_rope *rope_; // Pointer to the container being iterated over
+            std::size_t fragment_; // Index of the current fragment, or the number of fragments at the end
+            std::size_t pos_; // Index of the current character within the current fragment
+            filtered_string_view::const_iterator iter_; // Position within the current fragment
+        };
+
+    public:
+        using const_iterator = iter;
+        using iterator = const_iterator;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        filtered_string_rope() noexcept = default;
+
+        filtered_string_rope(std::initializer_list<filtered_string_view> fragments);
+
+        // As with std::vector, appending invalidates iterators into the rope
+        auto push_back(const filtered_string_view &fragment) -> void;
+
+        // Precondition: n < size()
+        auto operator[](std::size_t n) const noexcept -> const char&;
+
+        // Flattens the rope with a single allocation, writing each fragment straight into the result
+        explicit operator std::string() const;
+
+        auto friend operator==(const filtered_string_rope &lhs, const filtered_string_rope &rhs) noexcept -> bool {
+            return lhs.size() == rhs.size() && (lhs <=> rhs) == std::strong_ordering::equal;
+        }
+
+        auto friend operator<=>(const filtered_string_rope &lhs, const filtered_string_rope &rhs) noexcept -> std::strong_ordering {
+            return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+        }
+
+        auto friend operator<<(std::ostream &os, const filtered_string_rope &rope) -> std::ostream&;
+
+        auto size() const noexcept -> std::size_t {
+            return offsets_.empty() ? 0 : offsets_.back();
+        }
+
+        auto empty() const noexcept -> bool {
+            return size() == 0;
+        }
+
+        auto fragments() const noexcept -> const std::vector<filtered_string_view>& {
+            return fragments_;
+        }
+
+        auto begin() const noexcept -> const_iterator {
+            return const_iterator(this, next_fragment(0));
+        }
+
+        auto end() const noexcept -> const_iterator {
+            return const_iterator(this, fragments_.size());
+        }
+
+        auto rbegin() const noexcept -> const_reverse_iterator {
+            return const_reverse_iterator{end()};
+        }
+
+        auto rend() const noexcept -> const_reverse_iterator {
+            return const_reverse_iterator{begin()};
+        }
+
+    private:
+        std::vector<filtered_string_view> fragments_;
+        std::vector<std::size_t> offsets_; // offsets_[i] is the total size of fragments_[0..i]
+
+        auto fragment_size(std::size_t fragment) const noexcept -> std::size_t {
+            return offsets_[fragment] - (fragment == 0 ? 0 : offsets_[fragment - 1]);
+        }
+
+        // First non-empty fragment at or after fragment, or the number of fragments if there is none
+        auto next_fragment(std::size_t fragment) const noexcept -> std::size_t;
+
+        // Last non-empty fragment before fragment. Precondition: there is one
+        auto prev_fragment(std::size_t fragment) const noexcept -> std::size_t;
+    };
+
+    auto operator<<(std::ostream &os, const filtered_string_rope &rope) -> std::ostream&;
+
+    // A minimal C++20 generator (std::generator only arrives in C++23): a coroutine which produces a lazily evaluated
+    // sequence of values, each computed when the consumer asks for it. A yielded value is only valid until the
+    // generator is resumed
+    template <typename T>
+    class generator {
+    public:
+        struct promise_type {
+            const T *value_ = nullptr;
+            std::exception_ptr exception_;
+
+            auto get_return_object() noexcept -> generator {
+                return generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            auto initial_suspend() const noexcept -> std::suspend_always {
+                return {};
+            }
+
+            auto final_suspend() const noexcept -> std::suspend_always {
+                return {};
+            }
+
+            auto yield_value(const T &value) noexcept -> std::suspend_always {
+                value_ = std::addressof(value);
+                return {};
+            }
+
+            auto return_void() const noexcept -> void {}
+
+            auto unhandled_exception() noexcept -> void {
+                exception_ = std::current_exception();
+            }
+        };
+
+        class iterator {
+        friend generator;
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() noexcept = default;
+
+            auto operator*() const noexcept -> const T& {
+                return *handle_.promise().value_;
+            }
+
+            auto operator++() -> iterator& {
+                handle_.resume();
+                rethrow();
+                return *this;
+            }
+
+            auto operator++(int) -> void {
+                ++*this;
+            }
+
+            friend auto operator==(const iterator &iter, std::default_sentinel_t) noexcept -> bool {
+                return !iter.handle_ || iter.handle_.done();
+            }
+
+        private:
+            explicit iterator(std::coroutine_handle<promise_type> handle) noexcept: handle_{handle} {}
+
+            auto rethrow() const -> void {
+                if (handle_.done() && handle_.promise().exception_) {
+                    std::rethrow_exception(handle_.promise().exception_);
+                }
+            }
+
+            std::coroutine_handle<promise_type> handle_;
+        };
+
+        generator(const generator &) = delete;
+
+        generator(generator &&other) noexcept: handle_{std::exchange(other.handle_, nullptr)} {}
+
+        ~generator() noexcept {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        auto operator=(const generator &) -> generator& = delete;
+
+        auto operator=(generator &&other) noexcept -> generator& {
+            if (this != &other) {
+                if (handle_) {
+                    handle_.destroy();
+                }
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+
+        // Runs the coroutine up to its first value. May only be called once
+        auto begin() -> iterator {
+            auto iter = iterator{handle_};
+            handle_.resume();
+            iter.rethrow();
+            return iter;
+        }
+
+        auto end() const noexcept -> std::default_sentinel_t {
+            return std::default_sentinel;
+        }
+
+    private:
+        explicit generator(std::coroutine_handle<promise_type> handle) noexcept: handle_{handle} {}
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    // Yields the filtered string of fsv as consecutive chunks of at most chunk_size characters, compacted into a buffer
+    // owned by the coroutine, so that e.g. compression or network writes can start before the whole view is filtered
+    // and only chunk_size characters are held at once. fsv is taken by value as the coroutine outlives the call
+    auto chunks(filtered_string_view fsv, std::size_t chunk_size = 4096) -> generator<std::string_view>;
+
+    // Yields the pieces which split() would produce, each as soon as the delimiter ending it has been found
+    auto lazy_split(filtered_string_view fsv, filtered_string_view tok) -> generator<filtered_string_view>;
+
+    // A filtered string view whose predicate is part of its type rather than a std::function, so that it can be
+    // used in constant expressions, e.g. to filter fixed literals at compile time. Predicate may be a function pointer
+    // or a captureless lambda, as long as it can be called in a constant expression
+    template <typename Predicate = decltype(&filtered_string_view::default_predicate)>
+    class static_filtered_string_view {
+    public:
+        class const_iterator {
+        friend static_filtered_string_view;
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = char;
+            using reference_type = const value_type&;
+            using pointer_type = void;
+            using difference_type = std::ptrdiff_t;
+
+            constexpr const_iterator() noexcept = default;
+
+            constexpr auto operator*() const noexcept -> char {
+                return *pointer_;
+            }
+
+            constexpr auto operator++() noexcept -> const_iterator& {
+                ++pointer_;
+                while (pointer_ != fsv_->data_ + fsv_->length_ && !fsv_->predicate_(*pointer_)) {
+                    ++pointer_;
+                }
+                return *this;
+            }
+
+            constexpr auto operator++(int) noexcept -> const_iterator {
+                auto self = *this;
+                ++*this;
+                return self;
+            }
+
+            constexpr auto operator--() noexcept -> const_iterator& {
+                --pointer_;
+                while (!fsv_->predicate_(*pointer_)) {
+                    --pointer_;
+                }
+                return *this;
+            }
+
+            constexpr auto operator--(int) noexcept -> const_iterator {
+                auto self = *this;
+                --*this;
+                return self;
+            }
+
+            friend constexpr auto operator==(const const_iterator &lhs, const const_iterator &rhs) noexcept -> bool {
+                return lhs.pointer_ == rhs.pointer_;
+            }
+
+            // Position of the current character in the underlying string
+            constexpr auto base() const noexcept -> const char* {
+                return pointer_;
+            }
+
+        private:
+            constexpr const_iterator(const static_filtered_string_view *fsv, const char *pointer) noexcept:
+            fsv_{fsv}, pointer_{pointer} {}
+
+            const static_filtered_string_view *fsv_ = nullptr; // Pointer to the container being iterated over
+            const char *pointer_ = nullptr; // Pointer to the current character during iteration
+        };
+
+        using iterator = const_iterator;
+
+        constexpr static_filtered_string_view() noexcept = default;
+
+        constexpr static_filtered_string_view(const char *str, Predicate predicate = &filtered_string_view::default_predicate) noexcept:
+        data_{str}, length_{std::char_traits<char>::length(str)}, predicate_{predicate} {}
+
+        // Views the first length characters of str, which need not be null terminated
+        constexpr static_filtered_string_view(const char *str, std::size_t length, Predicate predicate = &filtered_string_view::default_predicate) noexcept:
+        data_{str}, length_{length}, predicate_{predicate} {}
+
+        // Precondition: n < size()
+        constexpr auto operator[](std::size_t n) const noexcept -> const char& {
+            auto iter = begin();
+            for (; n > 0; --n) {
+                ++iter;
+            }
+            return *iter.base();
+        }
+
+        constexpr auto at(int index) const -> const char& {
+            if (index < 0 || index >= static_cast<int>(size())) {
+                throw std::domain_error{"static_filtered_string_view::at: invalid index"};
+            }
+            return (*this)[static_cast<std::size_t>(index)];
+        }
+
+        constexpr auto data() const noexcept -> const char* {
+            return data_;
+        }
+
+        // Number of underlying characters, including those rejected by the predicate
+        constexpr auto length() const noexcept -> std::size_t {
+            return length_;
+        }
+
+        constexpr auto size() const noexcept -> std::size_t {
+            auto size = std::size_t{0};
+            for (auto i = std::size_t{0}; i < length_; ++i) {
+                if (predicate_(data_[i])) {
+                    ++size;
+                }
+            }
+            return size;
+        }
+
+        constexpr auto empty() const noexcept -> bool {
+            return begin() == end();
+        }
+
+        constexpr auto predicate() const noexcept -> const Predicate& {
+            return predicate_;
+        }
+
+        constexpr auto begin() const noexcept -> const_iterator {
+            auto pointer = data_;
+            while (pointer != data_ + length_ && !predicate_(*pointer)) {
+                ++pointer;
+            }
+            return const_iterator(this, pointer);
+        }
+
+        constexpr auto end() const noexcept -> const_iterator {
+            return const_iterator(this, data_ + length_);
+        }
+
+        template <typename Other>
+        friend constexpr auto operator==(const static_filtered_string_view &lhs, const static_filtered_string_view<Other> &rhs) noexcept -> bool {
+            return (lhs <=> rhs) == std::strong_ordering::equal;
+        }
+
+        template <typename Other>
+        friend constexpr auto operator<=>(const static_filtered_string_view &lhs, const static_filtered_string_view<Other> &rhs) noexcept -> std::strong_ordering {
+            return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+        }
+
+        friend auto operator<<(std::ostream &os, const static_filtered_string_view &fsv) -> std::ostream& {
+            for (const auto c : fsv) {
+                os << c;
+            }
+            return os;
+        }
+
+    private:
+        const char *data_ = nullptr;
+        std::size_t length_ = 0;
+        Predicate predicate_ = {};
+    };
+
+    namespace detail {
+        // The number of characters of tok matched once c follows a partial match of pos < tok.size() characters. On a
+        // mismatch this falls back to the longest prefix of tok which the matched characters and c still end with, as
+        // the failure function of KMP would, but finds it directly so that no table need be built
+        template <typename TokPredicate>
+        constexpr auto advance_match(const static_filtered_string_view<TokPredicate> &tok, std::size_t pos, char c)
+        -> std::size_t {
+            const auto at = [&tok](std::size_t i) {
+                auto iter = tok.begin();
+                std::advance(iter, static_cast<std::ptrdiff_t>(i));
+                return *iter;
+            };
+            if (c == at(pos)) {
+                return pos + 1;
+            }
+            // The matched characters are tok[0, pos), so a candidate prefix tok[0, next) must end in c and otherwise
+            // agree with the last next - 1 of them
+            for (auto next = pos; next != 0; --next) {
+                auto i = std::size_t{0};
+                while (i + 1 < next && at(i) == at(pos + 1 - next + i)) {
+                    ++i;
+                }
+                if (i + 1 == next && at(next - 1) == c) {
+                    return next;
+                }
+            }
+            return 0;
+        }
+
+        // Calls visit(first, last) with the source range of each piece of fsv separated by tok, using the same
+        // matching as split() on a filtered_string_view
+        template <typename Predicate, typename TokPredicate, typename Visit>
+        constexpr auto visit_split(const static_filtered_string_view<Predicate> &fsv,
+                                   const static_filtered_string_view<TokPredicate> &tok, Visit visit) -> void {
+            const auto last = fsv.data() + fsv.length();
+            auto piece = fsv.data();
+            auto tok_pos = std::size_t{0};
+            for (auto iter = fsv.begin(); iter != fsv.end(); ++iter) {
+                tok_pos = advance_match(tok, tok_pos, *iter);
+                if (tok_pos == tok.size()) {
+                    // The delimiter is the last tok.size() filtered characters, ending at iter
+                    auto start = iter;
+                    for (auto i = std::size_t{1}; i < tok.size(); ++i) {
+                        --start;
+                    }
+                    visit(piece, start.base());
+                    piece = iter.base() + 1;
+                    tok_pos = 0;
+                }
+            }
+            visit(piece, last);
+        }
+    }
+
+    template <typename Predicate>
+    constexpr auto substr(const static_filtered_string_view<Predicate> &fsv, int pos = 0, int count = 0) noexcept
+    -> static_filtered_string_view<Predicate> {
+        const auto rcount = count <= 0 ? static_cast<int>(fsv.size()) - pos : count;
+        auto iter = fsv.begin();
+        for (auto i = 0; i < pos && iter != fsv.end(); ++i) {
+            ++iter;
+        }
+        const auto start = iter == fsv.end() ? fsv.data() + fsv.length() : iter.base();
+        if (rcount <= 0) {
+            return static_filtered_string_view<Predicate>(start, 0, fsv.predicate());
+        }
+        for (auto i = 1; i < rcount && iter != fsv.end(); ++i) {
+            ++iter;
+        }
+        const auto end = iter == fsv.end() ? fsv.data() + fsv.length() : iter.base() + 1;
+        return static_filtered_string_view<Predicate>(start, static_cast<std::size_t>(end - start), fsv.predicate());
+    }
+
+    // Number of pieces split() will produce, for use as its template argument
+    template <typename Predicate, typename TokPredicate>
+    constexpr auto split_count(const static_filtered_string_view<Predicate> &fsv,
+                               const static_filtered_string_view<TokPredicate> &tok) noexcept -> std::size_t {
+        if (tok.empty()) {
+            return 1;
+        }
+        auto count = std::size_t{0};
+        detail::visit_split(fsv, tok, [&count](const char *, const char *) { ++count; });
+        return count;
+    }
+
+    // Splits fsv in the same way as split() on a filtered_string_view, into exactly N pieces
+    template <std::size_t N, typename Predicate, typename TokPredicate>
+    constexpr auto split(const static_filtered_string_view<Predicate> &fsv,
+                         const static_filtered_string_view<TokPredicate> &tok) -> std::array<static_filtered_string_view<Predicate>, N> {
+        if (split_count(fsv, tok) != N) {
+            throw std::length_error{"split: N does not match split_count()"};
+        }
+        auto split_strings = std::array<static_filtered_string_view<Predicate>, N>{};
+        if (tok.empty()) {
+            split_strings[0] = fsv;
+            return split_strings;
+        }
+        auto i = std::size_t{0};
+        detail::visit_split(fsv, tok, [&](const char *first, const char *last) {
+            split_strings[i++] = static_filtered_string_view<Predicate>(first, static_cast<std::size_t>(last - first), fsv.predicate());
+        });
+        return split_strings;
+    }
+
+    // Copies the filtered string into an array of N characters, padding any remainder with '\0'
+    template <std::size_t N, typename Predicate>
+    constexpr auto to_array(const static_filtered_string_view<Predicate> &fsv) -> std::array<char, N> {
+        if (fsv.size() > N) {
+            throw std::length_error{"to_array: filtered string does not fit in N characters"};
+        }
+        auto array = std::array<char, N>{};
+        std::copy(fsv.begin(), fsv.end(), array.begin());
+        return array;
+    }
 }
 
+template <>
+struct std::hash<fsv::filtered_string_view> {
+    // FNV-1a over the filtered characters, so that views with the same filtered string hash alike
+    auto operator()(const fsv::filtered_string_view &fsv) const -> std::size_t;
+};
+
+template <>
+struct std::hash<fsv::transformed_string_view> {
+    // FNV-1a over the transformed characters, computed in the same single pass as materialisation
+    auto operator()(const fsv::transformed_string_view &tsv) const -> std::size_t;
+};
+
+template <>
+struct std::hash<fsv::filtered_string_rope> {
+    // FNV-1a over the characters of every fragment in order, so it does not depend on where fragments are divided
+    auto operator()(const fsv::filtered_string_rope &rope) const -> std::size_t;
+};
+
 #endif // COMP6771_ASS2_FSV_H
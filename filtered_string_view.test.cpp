@@ -3,6 +3,8 @@
 #include <catch2/catch.hpp>
 #include <cctype>
 #include <compare>
+#include <array>
+#include <memory_resource>
 #include <cstddef>
 #include <set>
 #include <stdexcept>
@@ -11,6 +13,15 @@
 #include <iterator>
 #include <bits/stdc++.h>
 
+namespace {
+  // The filtered strings of views, so that results can be compared on their characters alone
+  auto strings(const std::vector<fsv::filtered_string_view> &views) -> std::vector<std::string> {
+    auto result = std::vector<std::string>{};
+    std::transform(views.begin(), views.end(), std::back_inserter(result), [](const auto &view) { return static_cast<std::string>(view); });
+    return result;
+  }
+}
+
 TEST_CASE("default_predicate always returns true") {
   for (char c = std::numeric_limits<char>::min(); c != std::numeric_limits<char>::max(); c++) {
     CHECK(fsv::filtered_string_view::default_predicate(c));
@@ -47,6 +58,16 @@ TEST_CASE("Null-Terminated String with Predicate Constructor") {
   CHECK(sv.size() == 1);
 }
 
+TEST_CASE("Bounded String with Predicate Constructor") {
+  const auto pred = [](const char &c) { return c != 'a'; };
+  const auto buffer = std::array<char, 6>{'c', 'a', 't', 'c', 'a', 't'};
+  const auto sv = fsv::filtered_string_view{buffer.data(), 3, pred};
+  CHECK(sv.size() == 2);
+  CHECK(sv.length() == 3);
+  CHECK(sv == "ct");
+  CHECK(sv[1] == 't');
+}
+
 TEST_CASE("Copy constructor") {
   const auto sv = fsv::filtered_string_view{"bulldog"};
   const auto copy = sv;
@@ -539,3 +560,801 @@ TEST_CASE("Reverse Iterator with custom predicate: filtered string contains firs
   CHECK(*iter == 'd');
   CHECK(iter == fsv.rbegin());
 }
+
+TEST_CASE("match_index rank and select") {
+  const auto s = std::string(1500, 'a') + std::string(1500, 'b');
+  const auto is_b = [](const char &c) { return c == 'b'; };
+  const auto index = fsv::match_index{s.data(), s.size(), is_b};
+  CHECK(index.length() == 3000);
+  CHECK(index.count() == 1500);
+  CHECK(!index.test(1499));
+  CHECK(index.test(1500));
+  CHECK(index.rank(1500) == 0);
+  CHECK(index.rank(2000) == 500);
+  CHECK(index.rank(3000) == 1500);
+  CHECK(index.select(0) == 1500);
+  CHECK(index.select(1499) == 2999);
+  CHECK(index.select(1500) == 3000);
+}
+
+TEST_CASE("build_index() preserves size, subscript, iteration and substr") {
+  const auto vowels = std::set<char>{'a', 'e', 'i', 'o', 'u'};
+  const auto is_vowel = [&vowels](const char &c){ return vowels.contains(c); };
+  auto s = std::string{};
+  for (auto i = 0; i < 200; ++i) {
+    s += "the quick brown fox jumps over the lazy dog ";
+  }
+  const auto plain = fsv::filtered_string_view{s, is_vowel};
+  auto indexed = plain;
+  indexed.build_index();
+  CHECK(indexed.has_index());
+  CHECK(!plain.has_index());
+  CHECK(indexed.size() == plain.size());
+  CHECK(indexed == plain);
+  CHECK(static_cast<std::string>(indexed) == static_cast<std::string>(plain));
+  for (auto i = 0; i < static_cast<int>(plain.size()); i += 97) {
+    CHECK(&indexed[i] == &plain[i]);
+  }
+  CHECK(fsv::substr(indexed, 100, 50) == fsv::substr(plain, 100, 50));
+  CHECK(std::equal(indexed.rbegin(), indexed.rend(), plain.rbegin(), plain.rend()));
+
+  // Copies share the index
+  const auto copy = indexed;
+  CHECK(copy.has_index());
+  CHECK(copy.size() == plain.size());
+}
+
+TEST_CASE("split, compose and to_string allocate from the given memory resource") {
+  auto buffer = std::array<std::byte, 4096>{};
+  auto arena = std::pmr::monotonic_buffer_resource{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+
+  const auto sv = fsv::filtered_string_view{"0xDEA / DBEEF / 0xde / adbeef"};
+  const auto tok = fsv::filtered_string_view{" / "};
+  const auto v = fsv::split(sv, tok, &arena);
+  CHECK(v.get_allocator().resource() == &arena);
+  CHECK(std::equal(v.begin(), v.end(), fsv::split(sv, tok).begin()));
+  CHECK(v.size() == 4);
+
+  const auto filts = std::vector<fsv::filter>{
+    [](const char &c) { return c != ' '; },
+    [](const char &c) { return c != '/'; },
+  };
+  const auto composed = fsv::compose(sv, filts, &arena);
+  CHECK(composed == fsv::compose(sv, filts));
+
+  // Neither copying the composed view nor splitting it falls back to the default resource
+  const auto previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  const auto copy = composed;
+  const auto pieces = fsv::split(copy, "0x", &arena);
+  std::pmr::set_default_resource(previous);
+  CHECK(copy == composed);
+  CHECK(pieces.size() == 3);
+
+  const auto s = fsv::to_string(composed, &arena);
+  CHECK(s.get_allocator().resource() == &arena);
+  CHECK(s == "0xDEADBEEF0xdeadbeef");
+}
+
+TEST_CASE("to_string reads the string no more than iterating it does") {
+  auto calls = std::size_t{0};
+  auto sv = fsv::filtered_string_view{"a-b-c", [&calls](const char &c) { ++calls; return c != '-'; }};
+  auto arena = std::pmr::monotonic_buffer_resource{};
+  (void) std::string(sv.begin(), sv.end());
+  const auto iterated = std::exchange(calls, 0);
+  CHECK(fsv::to_string(sv, &arena) == "abc");
+  const auto converted = std::exchange(calls, 0);
+  CHECK(converted <= iterated);
+  CHECK(static_cast<std::string>(sv) == "abc");
+  CHECK(calls == converted);
+
+  sv.build_index();
+  calls = 0;
+  CHECK(fsv::to_string(sv, &arena) == "abc");
+  CHECK(calls == 0);
+}
+
+TEST_CASE("static_filtered_string_view in constant expressions") {
+  constexpr auto is_upper = [](const char &c) { return c >= 'A' && c <= 'Z'; };
+  constexpr auto sv = fsv::static_filtered_string_view{"Content-Type", is_upper};
+  STATIC_REQUIRE(sv.size() == 2);
+  STATIC_REQUIRE(sv[0] == 'C');
+  STATIC_REQUIRE(sv[1] == 'T');
+  STATIC_REQUIRE(sv == fsv::static_filtered_string_view{"CT"});
+  STATIC_REQUIRE(sv < fsv::static_filtered_string_view{"CU"});
+
+  constexpr auto arr = fsv::to_array<sv.size() + 1>(sv);
+  STATIC_REQUIRE(arr == std::array<char, 3>{'C', 'T', '\0'});
+  CHECK_THROWS_AS(fsv::to_array<1>(sv), std::length_error);
+  CHECK_THROWS_AS(sv.at(2), std::domain_error);
+}
+
+TEST_CASE("static_filtered_string_view substr matches filtered_string_view") {
+  constexpr auto is_upper = [](const char &c) { return c >= 'A' && c <= 'Z'; };
+  constexpr auto sv = fsv::static_filtered_string_view{"Sled Dog Do No Wrong", is_upper};
+  STATIC_REQUIRE(fsv::substr(sv, 0, 2) == fsv::static_filtered_string_view{"SD"});
+  STATIC_REQUIRE(fsv::substr(sv, 1, 2) == fsv::static_filtered_string_view{"DD"});
+  STATIC_REQUIRE(fsv::substr(sv, 3) == fsv::static_filtered_string_view{"NW"});
+  STATIC_REQUIRE(fsv::substr(sv, 0, 0) == sv);
+  STATIC_REQUIRE(fsv::substr(sv, 5).empty());
+}
+
+TEST_CASE("static_filtered_string_view split matches filtered_string_view") {
+  constexpr auto is_hex = [](const char &c) { return c != '0' && c != 'x'; };
+  constexpr auto sv = fsv::static_filtered_string_view{"0xDEA / DBEEF / 0xde / adbeef", is_hex};
+  constexpr auto tok = fsv::static_filtered_string_view{" / "};
+  constexpr auto parts = fsv::split<fsv::split_count(sv, tok)>(sv, tok);
+  STATIC_REQUIRE(parts.size() == 4);
+  STATIC_REQUIRE(parts[0] == fsv::static_filtered_string_view{"DEA"});
+  STATIC_REQUIRE(parts[3] == fsv::static_filtered_string_view{"adbeef"});
+
+  constexpr auto xs = fsv::static_filtered_string_view{"xxx"};
+  constexpr auto x = fsv::static_filtered_string_view{"x"};
+  constexpr auto empties = fsv::split<fsv::split_count(xs, x)>(xs, x);
+  STATIC_REQUIRE(empties.size() == 4);
+  STATIC_REQUIRE(empties[2].empty());
+
+  const auto runtime = fsv::split(fsv::filtered_string_view{"0xDEA / DBEEF / 0xde / adbeef", is_hex}, fsv::filtered_string_view{" / "});
+  REQUIRE(runtime.size() == parts.size());
+  for (auto i = std::size_t{0}; i < parts.size(); ++i) {
+    auto out = std::ostringstream{};
+    out << parts[i];
+    CHECK(out.str() == static_cast<std::string>(runtime[i]));
+  }
+  CHECK_THROWS_AS(fsv::split<2>(sv, tok), std::length_error);
+}
+
+TEST_CASE("static_filtered_string_view split when a failed partial match overlaps the delimiter") {
+  constexpr auto sv = fsv::static_filtered_string_view{"xaabyaab"};
+  constexpr auto tok = fsv::static_filtered_string_view{"aab"};
+  constexpr auto parts = fsv::split<fsv::split_count(sv, tok)>(sv, tok);
+  STATIC_REQUIRE(parts.size() == 3);
+  STATIC_REQUIRE(parts[0] == fsv::static_filtered_string_view{"x"});
+  STATIC_REQUIRE(parts[1] == fsv::static_filtered_string_view{"y"});
+  STATIC_REQUIRE(parts[2].empty());
+
+  // The fallback is found through the filter, and agrees with split() on a filtered_string_view
+  constexpr auto no_dots = [](const char &c) { return c != '.'; };
+  constexpr auto dotted = fsv::static_filtered_string_view{"a.b.a.b.a.b.c.d", no_dots};
+  constexpr auto ababc = fsv::static_filtered_string_view{"ababc"};
+  STATIC_REQUIRE(fsv::split_count(dotted, ababc) == 2);
+  constexpr auto halves = fsv::split<2>(dotted, ababc);
+  STATIC_REQUIRE(halves[0] == fsv::static_filtered_string_view{"ab"});
+  STATIC_REQUIRE(halves[1] == fsv::static_filtered_string_view{"d"});
+  CHECK(strings(fsv::split(fsv::filtered_string_view{"a.b.a.b.a.b.c.d", no_dots}, "ababc")) == std::vector<std::string>{"ab", "d"});
+}
+
+TEST_CASE("tokenize with single character delimiters") {
+  const auto sv = fsv::filtered_string_view{"a,b;;c d", [](const char &c) { return c != ' '; }};
+  const auto tokens = fsv::tokenize(sv, ",", ";");
+  REQUIRE(tokens.size() == 4);
+  CHECK(tokens[0].view == "a");
+  CHECK(tokens[0].delimiter == 0);
+  CHECK(tokens[1].view == "b");
+  CHECK(tokens[1].delimiter == 1);
+  CHECK(tokens[2].view == "");
+  CHECK(tokens[2].delimiter == 1);
+  CHECK(tokens[3].view == "cd");
+  CHECK(tokens[3].delimiter == -1);
+}
+
+TEST_CASE("tokenize with multi-character delimiters") {
+  const auto sv = fsv::filtered_string_view{"key=1\r\nk||ey=2,x;\r\n"};
+  const auto tokens = fsv::tokenize(sv, ",", ";", "\r\n", "||");
+  REQUIRE(tokens.size() == 6);
+  CHECK(tokens[0].view == "key=1");
+  CHECK(tokens[0].delimiter == 2);
+  CHECK(tokens[1].view == "k");
+  CHECK(tokens[1].delimiter == 3);
+  CHECK(tokens[2].view == "ey=2");
+  CHECK(tokens[2].delimiter == 0);
+  CHECK(tokens[3].view == "x");
+  CHECK(tokens[3].delimiter == 1);
+  CHECK(tokens[4].view == "");
+  CHECK(tokens[4].delimiter == 2);
+  CHECK(tokens[5].view == "");
+  CHECK(tokens[5].delimiter == -1);
+}
+
+TEST_CASE("tokenize ignores an empty delimiter among multi-character ones") {
+  const auto sv = fsv::filtered_string_view{"a,,b;c"};
+  const auto tokens = fsv::tokenize(sv, std::vector<fsv::filtered_string_view>{",,", "", ";"});
+  REQUIRE(tokens.size() == 3);
+  CHECK(tokens[0].view == "a");
+  CHECK(tokens[0].delimiter == 0);
+  CHECK(tokens[1].view == "b");
+  CHECK(tokens[1].delimiter == 2);
+  CHECK(tokens[2].view == "c");
+  CHECK(tokens[2].delimiter == -1);
+  CHECK(tokens[2].view.length() == 1);
+}
+
+TEST_CASE("tokenize prefers the longest delimiter completing on a character") {
+  const auto sv = fsv::filtered_string_view{"a\r\nb\nc"};
+  const auto tokens = fsv::tokenize(sv, std::vector<fsv::filtered_string_view>{"\n", "\r\n"});
+  REQUIRE(tokens.size() == 3);
+  CHECK(tokens[0].view == "a");
+  CHECK(tokens[0].delimiter == 1);
+  CHECK(tokens[1].view == "b");
+  CHECK(tokens[1].delimiter == 0);
+  CHECK(tokens[2].view == "c");
+}
+
+TEST_CASE("tokenize agrees with split for a single delimiter") {
+  const auto interest = std::set<char>{'a', 'A', 'b', 'B', 'c', 'C', 'd', 'D', 'e', 'E', 'f', 'F', ' ', '/'};
+  const auto sv = fsv::filtered_string_view{"0xDEA / DBEEF / 0xde / adbeef", [&interest](const char &c){ return interest.contains(c); }};
+  const auto tok = fsv::filtered_string_view{" / "};
+  const auto tokens = fsv::tokenize(sv, tok);
+  const auto pieces = fsv::split(sv, tok);
+  REQUIRE(tokens.size() == pieces.size());
+  for (auto i = std::size_t{0}; i < pieces.size(); ++i) {
+    CHECK(tokens[i].view == pieces[i]);
+  }
+  CHECK(fsv::tokenize(sv, "").size() == 1);
+  CHECK(fsv::tokenize(fsv::filtered_string_view{}, "x").front().view.empty());
+
+  // Delimiters which overlap themselves, so that a failed partial match may hide the start of a real one
+  const auto no_spaces = [](const char &c) { return c != ' '; };
+  for (const auto &[s, t] : {std::pair{"xaaby a ab", "ab"}, std::pair{"a|| |||b|", "||"}, std::pair{"aaa ab aaab", "aab"}}) {
+    const auto overlapping = fsv::filtered_string_view{s, no_spaces};
+    auto views = std::vector<fsv::filtered_string_view>{};
+    for (const auto &token : fsv::tokenize(overlapping, t)) {
+      views.push_back(token.view);
+    }
+    CHECK(strings(views) == strings(fsv::split(overlapping, t)));
+  }
+}
+
+TEST_CASE("tokenize views only the characters of each token") {
+  // The buffer is not null terminated, so a token reading past its range would run off the end
+  const auto buffer = std::string_view{"key=value;next=1;"};
+  const auto sv = fsv::filtered_string_view{buffer.data(), buffer.size() - 1};
+  const auto tokens = fsv::tokenize(sv, "=", ";");
+  REQUIRE(tokens.size() == 4);
+  CHECK(tokens[0].view.length() == 3);
+  CHECK(tokens[1].view.length() == 5);
+  CHECK(tokens[2].view.length() == 4);
+  CHECK(tokens[3].view.length() == 1);
+  CHECK(tokens[3].view == "1");
+}
+
+TEST_CASE("transformed_string_view with a transform function") {
+  const auto is_alpha = [](const char &c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; };
+  const auto to_lower = [](const char &c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); };
+  const auto tsv = fsv::transformed_string_view{fsv::filtered_string_view{"Content-Type: 42", is_alpha}, to_lower};
+  CHECK(static_cast<std::string>(tsv) == "contenttype");
+  CHECK(tsv.size() == 11);
+  CHECK(tsv[0] == 'c');
+  CHECK(tsv[7] == 't');
+  CHECK(std::string(tsv.begin(), tsv.end()) == "contenttype");
+  CHECK(std::string(tsv.rbegin(), tsv.rend()) == "epyttnetnoc");
+  CHECK(std::bidirectional_iterator<fsv::transformed_string_view::iterator>);
+  auto out = std::ostringstream{};
+  out << tsv;
+  CHECK(out.str() == "contenttype");
+
+  // Conversion reads each character of the underlying string once
+  auto calls = std::size_t{0};
+  const auto counted = fsv::transformed_string_view{fsv::filtered_string_view{"Content-Type: 42", [&](const char &c) { ++calls; return is_alpha(c); }}, to_lower};
+  CHECK(static_cast<std::string>(counted) == "contenttype");
+  CHECK(calls == 16);
+}
+
+TEST_CASE("transformed_string_view with a transform table compares and hashes on transformed characters") {
+  auto lower = fsv::transform_table{};
+  for (auto i = 0; i < 256; ++i) {
+    lower[static_cast<std::size_t>(i)] = static_cast<char>(std::tolower(i));
+  }
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  const auto a = fsv::transformed_string_view{fsv::filtered_string_view{"Content-Type", no_dash}, lower};
+  const auto b = fsv::transformed_string_view{fsv::filtered_string_view{"CONTENTTYPE"}, lower};
+  const auto c = fsv::transformed_string_view{fsv::filtered_string_view{"content-typf", no_dash}, lower};
+  const auto d = fsv::transformed_string_view{fsv::filtered_string_view{"contenttype-x"}, lower};
+  CHECK(a == b);
+  CHECK(std::hash<fsv::transformed_string_view>{}(a) == std::hash<fsv::transformed_string_view>{}(b));
+  CHECK(a < c);
+  CHECK(a < d);
+  CHECK(d > b);
+  CHECK(static_cast<std::string>(b) == "contenttype");
+}
+
+TEST_CASE("filtered_string_rope indexes and iterates across fragments") {
+  const auto is_alpha = [](const char &c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; };
+  const auto rope = fsv::filtered_string_rope{
+    fsv::filtered_string_view{"1he2l"},
+    fsv::filtered_string_view{""},
+    fsv::filtered_string_view{"l3o, ", is_alpha},
+    fsv::filtered_string_view{"123", is_alpha},
+    fsv::filtered_string_view{" world"},
+  };
+  CHECK(rope.size() == 13);
+  CHECK(rope.fragments().size() == 5);
+  CHECK(rope[0] == '1');
+  CHECK(rope[4] == 'l');
+  CHECK(rope[5] == 'l');
+  CHECK(rope[6] == 'o');
+  CHECK(rope[7] == ' ');
+  CHECK(rope[12] == 'd');
+  CHECK(std::string(rope.begin(), rope.end()) == "1he2llo world");
+  CHECK(std::string(rope.rbegin(), rope.rend()) == "dlrow oll2eh1");
+  CHECK(static_cast<std::string>(rope) == "1he2llo world");
+  CHECK(std::bidirectional_iterator<fsv::filtered_string_rope::iterator>);
+
+  auto out = std::ostringstream{};
+  out << rope;
+  CHECK(out.str() == "1he2llo world");
+}
+
+TEST_CASE("filtered_string_rope indexes a fragment without rescanning it") {
+  auto calls = std::size_t{0};
+  const auto s = std::string(1000, 'a');
+  auto rope = fsv::filtered_string_rope{};
+  rope.push_back(fsv::filtered_string_view{s, [&calls](const char &) { ++calls; return true; }});
+  CHECK(calls == 1000);
+  CHECK(rope.fragments().front().has_index());
+  CHECK(&rope[999] == s.data() + 999);
+  CHECK(calls == 1000);
+}
+
+TEST_CASE("filtered_string_rope compares and hashes on content regardless of fragmentation") {
+  auto a = fsv::filtered_string_rope{};
+  a.push_back("abc");
+  a.push_back("def");
+  const auto b = fsv::filtered_string_rope{"a", "bcde", "", "f"};
+  const auto c = fsv::filtered_string_rope{"abcdeg"};
+  const auto d = fsv::filtered_string_rope{"abcde"};
+  CHECK(a == b);
+  CHECK(std::hash<fsv::filtered_string_rope>{}(a) == std::hash<fsv::filtered_string_rope>{}(b));
+  CHECK(a < c);
+  CHECK(d < a);
+  CHECK(a != d);
+  CHECK(fsv::filtered_string_rope{}.empty());
+  CHECK(fsv::filtered_string_rope{} == fsv::filtered_string_rope{""});
+}
+
+TEST_CASE("from_chars parses integers from contiguous and scattered characters") {
+  const auto digits = [](const char &c) { return std::isdigit(static_cast<unsigned char>(c)) != 0 || c == '-'; };
+  auto value = 0;
+  const auto contiguous = fsv::filtered_string_view{"id: -1234;", digits};
+  auto result = fsv::from_chars(contiguous, value);
+  CHECK(result.ec == std::errc{});
+  CHECK(result.count == 5);
+  CHECK(value == -1234);
+
+  const auto scattered = fsv::filtered_string_view{"1,234,567", digits};
+  auto big = std::int64_t{0};
+  result = fsv::from_chars(scattered, big);
+  CHECK(result.ec == std::errc{});
+  CHECK(result.count == 7);
+  CHECK(big == 1234567);
+
+  auto hex = 0u;
+  CHECK(fsv::from_chars(fsv::filtered_string_view{"ff"}, hex, 16).ec == std::errc{});
+  CHECK(hex == 255);
+
+  auto small = std::int8_t{0};
+  CHECK(fsv::from_chars(fsv::filtered_string_view{"300"}, small).ec == std::errc::result_out_of_range);
+  CHECK(fsv::from_chars(fsv::filtered_string_view{"abc"}, value).ec == std::errc::invalid_argument);
+  CHECK(fsv::from_chars(fsv::filtered_string_view{}, value).ec == std::errc::invalid_argument);
+}
+
+TEST_CASE("from_chars only gives up on numbers which overflow its buffer") {
+  // A short number followed by many scattered characters, of which only a buffer's worth are read
+  const auto trailing = "12_" + std::string(300, 'x');
+  auto calls = std::size_t{0};
+  const auto sv = fsv::filtered_string_view{trailing, [&calls](const char &c) { ++calls; return c != '_'; }};
+  auto value = 0;
+  auto result = fsv::from_chars(sv, value);
+  CHECK(result.ec == std::errc{});
+  CHECK(result.count == 2);
+  CHECK(value == 12);
+  CHECK(calls < 2 * fsv::detail::from_chars_buffer_size);
+
+  // A contiguous run is parsed in place whatever its length
+  const auto padded = std::string(300, '0') + "7;";
+  const auto digits = [](const char &c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+  result = fsv::from_chars(fsv::filtered_string_view{padded, digits}, value);
+  CHECK(result.ec == std::errc{});
+  CHECK(result.count == 301);
+  CHECK(value == 7);
+
+  auto scattered = std::string{};
+  for (auto i = std::size_t{0}; i < fsv::detail::from_chars_buffer_size; ++i) {
+    scattered += "0,";
+  }
+  scattered += "7";
+  CHECK(fsv::from_chars(fsv::filtered_string_view{scattered, digits}, value).ec == std::errc::value_too_large);
+}
+
+TEST_CASE("from_chars parses floating point numbers") {
+  const auto no_underscore = [](const char &c) { return c != '_'; };
+  auto value = 0.0;
+  const auto result = fsv::from_chars(fsv::filtered_string_view{"3_141.5_9e-3", no_underscore}, value);
+  CHECK(result.ec == std::errc{});
+  CHECK(result.count == 10);
+  CHECK(value == Approx(3.14159));
+
+  const auto long_scattered = std::string(200, '1') + "_" + std::string(200, '1');
+  auto ones = 0.0;
+  CHECK(fsv::from_chars(fsv::filtered_string_view{long_scattered, no_underscore}, ones).ec == std::errc::value_too_large);
+}
+
+TEST_CASE("incremental_filtered_string_view tracks an appended buffer") {
+  const auto no_digits = [](const char &c) { return std::isdigit(static_cast<unsigned char>(c)) == 0; };
+  auto log = std::string{"a1b2"};
+  auto tail = fsv::incremental_filtered_string_view{no_digits};
+  tail.refresh(log);
+  CHECK(tail.size() == 2);
+  CHECK(tail[1] == 'b');
+
+  log += std::string(1000, 'x') + "3c";
+  tail.refresh(log);
+  CHECK(tail.length() == log.size());
+  CHECK(tail.size() == 1003);
+  CHECK(tail[1002] == 'c');
+  CHECK(tail.view() == fsv::filtered_string_view{log, no_digits});
+  CHECK(tail.take_pieces().empty());
+  CHECK(tail.pending() == tail.view());
+}
+
+TEST_CASE("incremental_filtered_string_view views are bounded and keep the index") {
+  const auto no_digits = [](const char &c) { return std::isdigit(static_cast<unsigned char>(c)) == 0; };
+  // Not null terminated: only the first refreshed characters of the buffer have been written
+  auto buffer = std::vector<char>(64, 'z');
+  std::copy_n("a1b2c3", 6, buffer.begin());
+  auto tail = fsv::incremental_filtered_string_view{no_digits};
+  tail.refresh(buffer.data(), 4);
+  const auto before = tail.view();
+  CHECK(before.has_index());
+  CHECK(before.length() == 4);
+  CHECK(before.size() == 2);
+
+  // A later refresh extends the shared index without changing a view already taken
+  tail.refresh(buffer.data(), 6);
+  const auto after = tail.view();
+  CHECK(before.size() == 2);
+  CHECK(before == "ab");
+  CHECK(&before[2] == buffer.data() + before.length());
+  CHECK(after.size() == 3);
+  CHECK(after == "abc");
+
+  auto copy = tail;
+  copy.refresh(buffer.data(), 8);
+  CHECK(copy.size() == 5);
+  CHECK(tail.size() == 3);
+  CHECK(after.size() == 3);
+}
+
+TEST_CASE("incremental_filtered_string_view is empty but usable after a move") {
+  const auto log = std::string{"a1b2\nc3"};
+  auto tail = fsv::incremental_filtered_string_view{[](const char &c) { return c != '1'; }, "\n"};
+  tail.refresh(log);
+  auto moved = std::move(tail);
+  CHECK(moved.size() == 6);
+  CHECK(moved.take_pieces().size() == 1);
+  CHECK(tail.size() == 0);
+  CHECK(tail.length() == 0);
+  CHECK(tail.view().data() == nullptr);
+  CHECK(tail.take_pieces().empty());
+
+  // The moved-from object can be refreshed, copied and assigned again
+  tail.refresh(log);
+  CHECK(tail.size() == log.size());
+  const auto copy = tail;
+  CHECK(copy.view() == fsv::filtered_string_view{log});
+  moved = std::move(tail);
+  CHECK(moved.size() == log.size());
+  CHECK(tail.size() == 0);
+}
+
+TEST_CASE("incremental_filtered_string_view restarts a partial match which fails across refreshes") {
+  // The buffer is not null terminated, so a piece reading past its range would run off the end
+  auto buffer = std::vector<char>{'x', 'a', 'a', 'b', 'y', 'a', 'a', 'a', 'b', 'z'};
+  auto tail = fsv::incremental_filtered_string_view{fsv::filtered_string_view::default_predicate, "aab"};
+  tail.refresh(buffer.data(), 3);
+  CHECK(tail.take_pieces().empty());
+  tail.refresh(buffer.data(), 7);
+  auto pieces = tail.take_pieces();
+  REQUIRE(pieces.size() == 1);
+  CHECK(pieces[0] == "x");
+  CHECK(pieces[0].length() == 1);
+  tail.refresh(buffer.data(), buffer.size());
+  pieces = tail.take_pieces();
+  REQUIRE(pieces.size() == 1);
+  CHECK(pieces[0] == "ya");
+  CHECK(pieces[0].length() == 2);
+  CHECK(tail.pending() == "z");
+  CHECK(tail.pending().length() == 1);
+}
+
+TEST_CASE("incremental_filtered_string_view splits across refreshes as split does") {
+  const auto no_spaces = [](const char &c) { return c != ' '; };
+  const auto tok = fsv::filtered_string_view{"\r\n"};
+  auto tail = fsv::incremental_filtered_string_view{no_spaces, tok};
+  auto log = std::string{"GET / 200\r"};
+  tail.refresh(log);
+  CHECK(tail.take_pieces().empty());
+  CHECK(tail.pending() == "GET/200\r");
+
+  // The delimiter straddles the refresh, and the buffer may move as it grows
+  log += "\nPOST / 201\r\n\r\nDEL";
+  log.shrink_to_fit();
+  tail.refresh(log);
+  const auto pieces = tail.take_pieces();
+  const auto expected = std::vector<fsv::filtered_string_view>{"GET/200", "POST/201", ""};
+  CHECK(pieces == expected);
+  CHECK(tail.take_pieces().empty());
+  CHECK(tail.pending() == "DEL");
+
+  auto all = pieces;
+  all.push_back(tail.pending());
+  CHECK(all == fsv::split(fsv::filtered_string_view{log, no_spaces}, tok));
+}
+
+TEST_CASE("split function after a failed partial match of the delimiter") {
+  const auto sv = fsv::filtered_string_view{"axab"};
+  const auto tok = fsv::filtered_string_view{"ab"};
+  const auto v = fsv::split(sv, tok);
+  const auto expected = std::vector<fsv::filtered_string_view>{"ax", ""};
+  CHECK(v == expected);
+}
+
+TEST_CASE("split function when a failed partial match overlaps the delimiter") {
+  const auto split = [](const char *s, const char *tok) { return strings(fsv::split(s, tok)); };
+  CHECK(split("xaaby", "ab") == std::vector<std::string>{"xa", "y"});
+  CHECK(split("aaab", "aab") == std::vector<std::string>{"a", ""});
+  CHECK(split("abababc", "ababc") == std::vector<std::string>{"ab", ""});
+  CHECK(split("aaaaa", "aa") == std::vector<std::string>{"", "", "a"});
+}
+
+TEST_CASE("every split variant agrees on self-overlapping delimiters") {
+  const auto no_spaces = [](const char &c) { return c != ' '; };
+  auto random = std::minstd_rand{7};
+  for (auto round = 0; round < 200; ++round) {
+    auto s = std::string{};
+    for (auto i = 0; i < 40; ++i) {
+      s += "ab "[random() % 3];
+    }
+    const auto sv = fsv::filtered_string_view{s, no_spaces};
+    for (const auto tok : {"a", "aa", "ab", "aab", "aba", "abab", "abaab"}) {
+      const auto expected = strings(fsv::split(sv, tok));
+      CHECK(strings(fsv::parallel_split(sv, tok, 1)) == expected);
+
+      auto lazy = std::vector<fsv::filtered_string_view>{};
+      for (const auto &piece : fsv::lazy_split(sv, tok)) {
+        lazy.push_back(piece);
+      }
+      CHECK(strings(lazy) == expected);
+
+      auto tokens = std::vector<fsv::filtered_string_view>{};
+      for (const auto &t : fsv::tokenize(sv, tok)) {
+        tokens.push_back(t.view);
+      }
+      CHECK(strings(tokens) == expected);
+
+      // Fed one character at a time, so every partial match straddles a refresh
+      auto tail = fsv::incremental_filtered_string_view{no_spaces, tok};
+      for (auto length = std::size_t{1}; length <= s.size(); ++length) {
+        tail.refresh(s.data(), length);
+      }
+      auto pieces = tail.take_pieces();
+      pieces.push_back(tail.pending());
+      CHECK(strings(pieces) == expected);
+    }
+  }
+}
+
+TEST_CASE("parallel_split produces exactly what split produces") {
+  const auto no_spaces = [](const char &c) { return c != ' '; };
+  // Records whose delimiters land on, and straddle, chunk boundaries
+  auto s = std::string{};
+  for (auto i = 0; s.size() < 3 * fsv::parallel_split_min_chunk; ++i) {
+    s += std::string(static_cast<std::size_t>(20 + i % 7), 'r') + (i % 5 == 0 ? "||||" : "|| |");
+  }
+  const auto sv = fsv::filtered_string_view{s, no_spaces};
+  for (const auto tok : {"||", "|||", "r|", "x"}) {
+    for (const auto threads : {1u, 3u, 4u}) {
+      CHECK(strings(fsv::parallel_split(sv, tok, threads)) == strings(fsv::split(sv, tok)));
+    }
+  }
+}
+
+TEST_CASE("parallel_split when a partial match carries across a whole chunk") {
+  // The second chunk never agrees with its own scan, since it is out of phase with the run of a's from the first
+  const auto bs = std::string(fsv::parallel_split_min_chunk - 1, 'b');
+  const auto s = bs + std::string(fsv::parallel_split_min_chunk + 1, 'a');
+  const auto sv = fsv::filtered_string_view{s};
+  const auto v = fsv::parallel_split(sv, "aaa", 2);
+  REQUIRE(v.size() == (fsv::parallel_split_min_chunk + 1) / 3 + 1);
+  CHECK(static_cast<std::string>(v.front()) == bs);
+  CHECK(std::all_of(v.begin() + 1, v.end() - 1, [](const auto &piece) { return piece.empty(); }));
+  CHECK(v.back() == "aa");
+  const auto whole = fsv::parallel_split(sv, "", 2);
+  REQUIRE(whole.size() == 1);
+  CHECK(whole.front().data() == s.data());
+  CHECK(fsv::parallel_split(fsv::filtered_string_view{}, "aaa", 2) == fsv::split(fsv::filtered_string_view{}, "aaa"));
+}
+
+TEST_CASE("parallel_split pieces are bounded by their own characters") {
+  // The buffer is not null terminated, so a piece reading past its range would run off the end
+  auto buffer = std::vector<char>{};
+  for (auto i = 0; buffer.size() < 2 * fsv::parallel_split_min_chunk; ++i) {
+    buffer.insert(buffer.end(), static_cast<std::size_t>(10 + i % 3), 'r');
+    buffer.push_back('|');
+  }
+  const auto sv = fsv::filtered_string_view{buffer.data(), buffer.size()};
+  const auto v = fsv::parallel_split(sv, "|", 2);
+  REQUIRE(v.size() > 2);
+  for (auto i = std::size_t{0}; i + 1 < v.size(); ++i) {
+    CHECK(v[i].length() == v[i].size());
+    CHECK(v[i].data()[v[i].length()] == '|');
+  }
+  CHECK(v.back().empty());
+}
+
+TEST_CASE("sort_views orders views as std::sort does") {
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  const auto long_a = std::string{"the-quick-brown-fox-jumps-a"};
+  const auto long_b = std::string{"thequickbrownfoxjumpsb"};
+  auto views = std::vector<fsv::filtered_string_view>{
+    {"banana"}, {"ban-ana", no_dash}, {"apple"}, {""}, {"\x80"}, {"a"}, {"ab"},
+    {long_b}, {long_a, no_dash}, {"Zebra"}, {"zebra"}, {"apple-pie", no_dash},
+  };
+  auto expected = views;
+  std::sort(expected.begin(), expected.end());
+  fsv::sort_views(views);
+  REQUIRE(views.size() == expected.size());
+  for (auto i = std::size_t{0}; i < views.size(); ++i) {
+    CHECK(static_cast<std::string>(views[i]) == static_cast<std::string>(expected[i]));
+  }
+  CHECK(std::is_sorted(views.begin(), views.end()));
+}
+
+TEST_CASE("unique_views removes consecutive duplicates as std::unique does") {
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  const auto long_a = std::string{"the-quick-brown-fox-jumps"};
+  const auto long_b = std::string{"thequickbrownfoxjumps"};
+  const auto long_c = std::string{"thequickbrownfoxjumpz"};
+  auto views = std::vector<fsv::filtered_string_view>{
+    {"apple"}, {"app-le", no_dash}, {"apple"}, {"banana"}, {long_a, no_dash}, {long_b}, {long_c}, {""}, {""}, {},
+  };
+  auto expected = views;
+  expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+  views.erase(fsv::unique_views(views), views.end());
+  REQUIRE(views.size() == expected.size());
+  CHECK(views.size() == 6);
+  for (auto i = std::size_t{0}; i < views.size(); ++i) {
+    CHECK(static_cast<std::string>(views[i]) == static_cast<std::string>(expected[i]));
+  }
+  CHECK(views.back().data() == nullptr);
+
+  auto empty = std::vector<fsv::filtered_string_view>{};
+  CHECK(fsv::unique_views(empty) == empty.end());
+}
+
+TEST_CASE("std::hash of filtered_string_view depends only on the filtered string") {
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  const auto hash = std::hash<fsv::filtered_string_view>{};
+  CHECK(hash(fsv::filtered_string_view{"con-tent", no_dash}) == hash(fsv::filtered_string_view{"content"}));
+  CHECK(hash(fsv::filtered_string_view{"content"}) == std::hash<fsv::filtered_string_rope>{}(fsv::filtered_string_rope{"con", "tent"}));
+  CHECK(hash(fsv::filtered_string_view{}) == hash(fsv::filtered_string_view{""}));
+}
+
+TEST_CASE("intern_pool stores each distinct filtered string once") {
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  auto pool = fsv::intern_pool{};
+  CHECK(!pool.find("content").has_value());
+  const auto a = pool.intern(fsv::filtered_string_view{"con-tent", no_dash});
+  const auto b = pool.intern("type");
+  const auto c = pool.intern("content");
+  const auto d = pool.intern("");
+  CHECK(a == c);
+  CHECK(a != b);
+  CHECK(pool.size() == 3);
+  CHECK(pool[a] == "content");
+  CHECK(pool[b] == "type");
+  CHECK(pool[d].empty());
+  CHECK(pool.find(fsv::filtered_string_view{"t-y-p-e", no_dash}) == b);
+  CHECK(!pool.find("typ").has_value());
+  CHECK(!pool.find("types").has_value());
+}
+
+TEST_CASE("intern_pool leaves its strings in place when interning one it already has") {
+  auto pool = fsv::intern_pool{};
+  for (auto i = 0; i < 32; ++i) {
+    pool.intern(std::to_string(i));
+  }
+  const auto seven = pool[pool.intern("7")];
+  const auto data = seven.data();
+  for (auto round = 0; round < 1000; ++round) {
+    CHECK(pool.intern(std::to_string(round % 32)) == static_cast<fsv::intern_pool::id>(round % 32));
+  }
+  CHECK(pool.size() == 32);
+  CHECK(pool[7].data() == data);
+  CHECK(seven == "7");
+}
+
+TEST_CASE("intern_pool keeps ids stable as it grows") {
+  auto pool = fsv::intern_pool{};
+  auto keys = std::vector<std::string>{};
+  for (auto i = 0; i < 1000; ++i) {
+    keys.push_back("key" + std::to_string(i % 250));
+  }
+  auto ids = std::vector<fsv::intern_pool::id>{};
+  for (const auto &key : keys) {
+    ids.push_back(pool.intern(key));
+  }
+  CHECK(pool.size() == 250);
+  for (auto i = std::size_t{0}; i < keys.size(); ++i) {
+    CHECK(ids[i] == ids[i % 250]);
+    CHECK(pool[ids[i]] == keys[i]);
+    CHECK(pool.find(keys[i]) == ids[i]);
+  }
+}
+
+TEST_CASE("chunks yields the filtered string in compacted chunks") {
+  const auto no_dash = [](const char &c) { return c != '-'; };
+  auto s = std::string{};
+  for (auto i = 0; i < 100; ++i) {
+    s += "ab-cd-";
+  }
+  auto out = std::string{};
+  auto sizes = std::vector<std::size_t>{};
+  for (const auto chunk : fsv::chunks(fsv::filtered_string_view{s, no_dash}, 64)) {
+    out += chunk;
+    sizes.push_back(chunk.size());
+  }
+  CHECK(out == static_cast<std::string>(fsv::filtered_string_view{s, no_dash}));
+  CHECK(sizes.size() == 7);
+  CHECK(std::all_of(sizes.begin(), sizes.end() - 1, [](const auto size) { return size == 64; }));
+  CHECK(sizes.back() == 16);
+
+  auto count = 0;
+  for (const auto chunk : fsv::chunks(fsv::filtered_string_view{})) {
+    (void)chunk;
+    ++count;
+  }
+  CHECK(count == 0);
+}
+
+TEST_CASE("chunks only filters as far as the consumer reads") {
+  auto calls = 0;
+  const auto counting = [&calls](const char &c) { ++calls; return c != ' '; };
+  const auto s = std::string(100000, 'x');
+  auto gen = fsv::chunks(fsv::filtered_string_view{s, counting}, 10);
+  auto iter = gen.begin();
+  CHECK(*iter == "xxxxxxxxxx");
+  CHECK(calls == 10);
+}
+
+TEST_CASE("lazy_split yields what split produces") {
+  const auto interest = std::set<char>{'a', 'A', 'b', 'B', 'c', 'C', 'd', 'D', 'e', 'E', 'f', 'F', ' ', '/'};
+  const auto sv = fsv::filtered_string_view{"0xDEA / DBEEF / 0xde / adbeef /  / ", [&interest](const char &c){ return interest.contains(c); }};
+  const auto tok = fsv::filtered_string_view{" / "};
+  auto pieces = std::vector<fsv::filtered_string_view>{};
+  for (const auto &piece : fsv::lazy_split(sv, tok)) {
+    pieces.push_back(piece);
+  }
+  CHECK(pieces == fsv::split(sv, tok));
+
+  auto whole = std::vector<fsv::filtered_string_view>{};
+  for (const auto &piece : fsv::lazy_split(sv, "")) {
+    whole.push_back(piece);
+  }
+  CHECK(whole == std::vector<fsv::filtered_string_view>{sv});
+}
+
+TEST_CASE("lazy_split restarts after a failed partial match and yields bounded pieces") {
+  // The buffer is not null terminated, so a piece reading past its range would run off the end
+  const auto buffer = std::vector<char>{'x', 'a', 'a', 'b', 'y', '-', 'a', 'a', 'a', 'b', 'z'};
+  const auto sv = fsv::filtered_string_view{buffer.data(), buffer.size(), [](const char &c) { return c != '-'; }};
+  auto pieces = std::vector<fsv::filtered_string_view>{};
+  for (const auto &piece : fsv::lazy_split(sv, "aab")) {
+    pieces.push_back(piece);
+  }
+  CHECK(strings(pieces) == std::vector<std::string>{"x", "ya", "z"});
+  CHECK(strings(pieces) == strings(fsv::split(sv, "aab")));
+  REQUIRE(pieces.size() == 3);
+  CHECK(pieces[0].length() == 1);
+  CHECK(pieces[1].length() == 3);
+  CHECK(pieces[2].length() == 1);
+}